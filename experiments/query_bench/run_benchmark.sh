@@ -0,0 +1,30 @@
+#!/bin/bash
+set -euo pipefail
+thisfolder=$( cd -- "$( dirname -- "${BASH_SOURCE[0]}" )" &> /dev/null && pwd ) # https://stackoverflow.com/questions/59895/how-do-i-get-the-directory-where-a-bash-script-is-located-from-within-the-script
+cd $thisfolder
+
+query=$thisfolder/../../eds-query
+inputmsa=$thisfolder/../covid/input/covid19-100-N.fa; if [ $# -gt 0 ] ; then inputmsa=$(realpath $1) ; fi
+threads=8; if [ $# -gt 1 ] ; then threads=$2 ; fi
+patterns=10000
+length=32
+seed=1
+
+echo -e "segmentation\tU\tperfect-columns\tblocks\tcardinality\tgap-aware-size\tpatterns/s\tMB/s"
+run() {
+	$query $inputmsa --random $patterns $length $seed "$@" | awk -v label="$*" '
+		/^Input file/ { split($0, f, ", "); for (i in f) { split(f[i], kv, ": "); opt[kv[1]] = kv[2] } }
+		/^EDS blocks/ { gsub(",", ""); blocks = $3; card = $5; size = $8 }
+		/^Throughput/ { pps = $2; mbs = $4 }
+		END { print opt["segmentation"] "\t" opt["upper bound"] "\t" opt["allow-perfect-segments"] "\t" blocks "\t" card "\t" size "\t" pps "\t" mbs }'
+}
+
+run 1 0 $threads --trivial
+for U in 4 8 16 32 64 128
+do
+	for pc in 0 1
+	do
+		run $U $pc $threads
+		run $U $pc $threads --greedy
+	done
+done
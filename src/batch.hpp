@@ -0,0 +1,207 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "block_graph.hpp"
+#include "mincard.hpp"
+#include "trace.hpp"
+#include "writer.hpp"
+
+/* batch mode over many MSAs in one process: the files are handed out largest first to a pool
+ * of threads, each keeping its buffers between files, and every output is written next to its
+ * MSA or appended to one archive with a tab-separated index */
+namespace eds::batch {
+    typedef eds::block_graph::seg_index seg_index;
+    using eds::mincard::objective;
+
+    struct options {
+        seg_index L = 1, U = 10;
+        bool allow_perfect_segments = false, trivial_segmentation = false, greedy_segmentation = false;
+        bool gfa_output = false, gfa_paths = true;
+        objective obj;
+    };
+
+    struct result {
+        std::string path;
+        seg_index rows = 0, columns = 0, card = 0, size = 0;
+        long long milliseconds = 0;
+        std::string error; // empty if the MSA was segmented
+    };
+
+    /* buffers of a worker thread, reused from one MSA to the next */
+    struct workspace {
+        vector<string> msa, names;
+        string output;
+    };
+
+    const vector<string> MSA_EXTENSIONS = { ".fa", ".fasta", ".fas", ".afa", ".mfa", ".aln" };
+
+    /* MSAs of a directory (files with an extension of MSA_EXTENSIONS), or of a manifest listing
+     * one path per line (# starts a comment), relative to the directory of the manifest
+     * returns: the paths, sorted for directories */
+    vector<string> list_inputs(const string &path, string &error) {
+        vector<string> inputs;
+        std::error_code ec;
+        if (std::filesystem::is_directory(path, ec)) {
+            for (auto &entry : std::filesystem::directory_iterator(path, ec)) {
+                const string extension = entry.path().extension().string();
+                if (entry.is_regular_file(ec) and std::find(MSA_EXTENSIONS.begin(), MSA_EXTENSIONS.end(), extension) != MSA_EXTENSIONS.end())
+                    inputs.push_back(entry.path().string());
+            }
+            std::sort(inputs.begin(), inputs.end());
+        } else {
+            ifstream in(path);
+            if (!in) {
+                error = "cannot read " + path;
+                return {};
+            }
+            const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+            string line;
+            while (std::getline(in, line)) {
+                line.erase(0, line.find_first_not_of(" \t"));
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (line.empty() or line[0] == '#')
+                    continue;
+                inputs.push_back((std::filesystem::path(line).is_relative()) ? (directory / line).string() : line);
+            }
+        }
+        if (inputs.empty())
+            error = "no MSA files in " + path;
+        return inputs;
+    }
+
+    /* segments the MSA at path as msa2eds-mincard does, leaving its GFA or EDS in ws.output */
+    void process(const string &path, const options &opt, workspace &ws, result &r) {
+        EDS_TRACE_SPAN("batch job");
+        auto start = std::chrono::steady_clock::now();
+        r.path = path;
+        ws.output.clear();
+        eds::mincard::read_fasta_into(path, ws.msa, &ws.names);
+        if (ws.msa.empty()) {
+            r.error = "empty or not found";
+            return;
+        }
+        if (!eds::mincard::rows_aligned(ws.msa)) {
+            r.error = "rows differ in length";
+            return;
+        }
+        const seg_index c = ws.msa[0].size();
+        r.rows = ws.msa.size();
+        r.columns = c;
+
+        vector<bool> perfect_columns = {}, gap_columns = {};
+        if (opt.allow_perfect_segments and !opt.trivial_segmentation)
+            perfect_columns = eds::mincard::compute_perfect_columns(ws.msa, &gap_columns).second;
+        eds::block_graph::segmentation segments;
+        if (opt.trivial_segmentation) {
+            segments.reserve(c);
+            for (seg_index y = 1; y <= c; ++y)
+                segments.push_back({ y, y });
+        } else if (opt.greedy_segmentation) {
+            segments = eds::mincard::segment_greedy(ws.msa, opt.U, perfect_columns).second;
+        } else {
+            auto L_y = eds::mincard::compute_meaningful_extensions(ws.msa, opt.L, opt.U, opt.obj);
+            segments = eds::mincard::segment_with_rmq(L_y, c, perfect_columns, opt.obj, gap_columns).second;
+        }
+
+        eds::column_store::in_memory_msa rows(ws.msa, &ws.names);
+        auto [g, card, size] = eds::block_graph::segment_columns(rows, segments, opt.gfa_output and opt.gfa_paths);
+        {
+            buffered_writer out(&ws.output);
+            if (opt.gfa_output)
+                eds::block_graph::output_gfa(g, r.rows, c, segments, out);
+            else
+                eds::block_graph::output_eds(g, out);
+        }
+        r.card = card;
+        r.size = size;
+        r.milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /* outputs appended in completion order to one file, indexed by path, byte offset and
+     * length in archive_path.idx */
+    class archive {
+    private:
+        std::ofstream data, index;
+        std::mutex mutex;
+        uint64_t offset = 0;
+
+    public:
+        explicit archive(const string &path) : data(path, std::ios::binary | std::ios::trunc), index(path + ".idx", std::ios::trunc) {}
+        bool good() const { return data.good() and index.good(); }
+        /* returns: false if an output could not be written whole */
+        bool close() {
+            data.close();
+            index.close();
+            return !data.fail() and !index.fail();
+        }
+        void append(const string &path, const string &output) {
+            std::lock_guard<std::mutex> lock(mutex);
+            data.write(output.data(), output.size());
+            index << path << "\t" << offset << "\t" << output.size() << "\n";
+            offset += output.size();
+        }
+    };
+
+    /* returns: the results in the order of inputs; outputs go to combined if given, opened by
+     * the caller so that it fails before any job, and next to every MSA (path.gfa or path.eds)
+     * otherwise */
+    vector<result> run(const vector<string> &inputs, const options &opt, unsigned threads, archive *combined = nullptr) {
+        // largest first, so that a large MSA does not start last on an otherwise idle pool
+        vector<std::pair<uintmax_t, std::size_t>> order;
+        for (std::size_t i = 0; i < inputs.size(); i++) {
+            std::error_code ec;
+            const uintmax_t bytes = std::filesystem::file_size(inputs[i], ec);
+            order.push_back({ (ec) ? 0 : bytes, i });
+        }
+        std::stable_sort(order.begin(), order.end(), [](auto &a, auto &b) { return a.first > b.first; });
+
+        vector<result> results(inputs.size());
+        std::atomic<std::size_t> next(0);
+        auto worker = [&]() {
+            workspace ws;
+            for (std::size_t k = next++; k < order.size(); k = next++) {
+                const std::size_t i = order[k].second;
+                process(inputs[i], opt, ws, results[i]);
+                if (!results[i].error.empty())
+                    continue;
+                if (combined) {
+                    combined->append(inputs[i], ws.output);
+                } else {
+                    std::ofstream out(inputs[i] + ((opt.gfa_output) ? ".gfa" : ".eds"), std::ios::binary | std::ios::trunc);
+                    out.write(ws.output.data(), ws.output.size());
+                    if (!out)
+                        results[i].error = "cannot write output";
+                }
+            }
+        };
+        vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &t : pool)
+            t.join();
+        if (combined and !combined->close())
+            for (auto &r : results)
+                if (r.error.empty())
+                    r.error = "cannot write archive";
+        return results;
+    }
+
+    /* tab-separated table with one line per MSA */
+    void output_summary(const vector<result> &results, std::ostream &out) {
+        out << "msa\trows\tcolumns\tcardinality\tsize\tmilliseconds\tstatus\n";
+        for (auto &r : results)
+            out << r.path << "\t" << r.rows << "\t" << r.columns << "\t" << r.card << "\t" << r.size << "\t" << r.milliseconds << "\t" << ((r.error.empty()) ? "ok" : r.error) << "\n";
+    }
+} // namespace eds::batch
+#endif // BATCH_HPP
@@ -1,14 +1,22 @@
 #ifndef BLOCK_GRAPH_HPP
 #define BLOCK_GRAPH_HPP
 #include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <limits>
 #include <set>
 #include <vector>
 #include <string>
 #include <fstream>
 #include <cassert>
+#include <cstdio>
 #include <iostream>
 #include <tuple>
 
+#include "column_store.hpp"
+#include "writer.hpp"
+#include "trace.hpp"
+
 using std::unordered_map;
 using std::unordered_set;
 using std::vector;
@@ -17,6 +25,8 @@ using std::ifstream, std::ofstream;
 using std::cerr, std::endl;
 using std::pair, std::tuple;
 using std::max;
+using eds::io::buffered_writer;
+using eds::column_store::row_classes, eds::column_store::segment_row_classes, eds::column_store::chunked_row_classes;
 
 // code adapted from https://github.com/algbio/founderblockgraphs/tree/rewrite
 namespace eds::block_graph {
@@ -31,13 +41,16 @@ namespace eds::block_graph {
         vector<unordered_map<string,unsigned long>> blocks; // each block is a sequence->node id map
         unordered_map<unsigned long,unsigned long> node_to_block; // node id -> its block
         unordered_map<unsigned long,unordered_set<unsigned long>> adjacency_lists; // node id -> out-neighbors
+        vector<pair<string,vector<unsigned long>>> paths; // sequence name -> node ids it spells (optional)
     };
 
     /* requires: segmentation S is sorted vector of pairs starting at (1,x) and ending at (y,n)
      * returns: elastic block graph (or a layered DAG if a segments contains the empty string)
-     * notes: MSA is streamed from disk, graph (no paths) is kept in memory */
-    tuple<block_graph,seg_index,seg_index> segment_msa(const string &msa_path, const long long n, const segmentation &S) {
+     * notes: MSA is streamed from disk, graph is kept in memory, and so are the paths
+     * spelling the input sequences if collect_paths is set */
+    tuple<block_graph,seg_index,seg_index> segment_msa(const string &msa_path, const long long n, const segmentation &S, bool collect_paths = false) {
         assert(S.at(0).first == 1 and S.back().second == n);
+        EDS_TRACE_SPAN("segment_msa");
 #ifdef BLOCK_GRAPH_HPP_DEBUG
         cerr << "DEBUG: segmentation segment starts are ";
         for (auto &[s, _] : S) cerr << " " << s;
@@ -48,57 +61,16 @@ namespace eds::block_graph {
         vector<unordered_map<string,unsigned long>> blocks(S.size());
         unordered_map<unsigned long,unsigned long> node_to_block;
         unordered_map<unsigned long,unordered_set<unsigned long>> adjacency_lists;
+        vector<pair<string,vector<unsigned long>>> paths;
         seg_index card = 0, size = 0; // gap-aware size
 
-        ifstream msa_if(msa_path);
-        string line = "", sequence = "";
-        while (getline(msa_if, line)) {
-            if (line.length() == 0) continue;
-            if (line[0] == '>' and sequence.length() > 0) {
-                assert(sequence.size() == n);
-
-                seg_index prev = SEG_INDEX_MAX;
-                for (seg_size_t i = 0; i < S.size(); i++) {
-                    assert(S[i].first <= S[i].second);
-
-                    string label = sequence.substr(S[i].first - 1, S[i].second - S[i].first + 1);
-                    label.erase(std::remove(label.begin(), label.end(), GAP_CHARACTER), label.end()); // remove gaps
-
-                    //if (label == "") // we allow gaps
-                    //    continue;
-
-                    if (blocks[i].find(label) != blocks[i].end()) {
-                        // node label in this block is already present
-                        const unsigned long id = blocks[i][label];
-                        if (prev != SEG_INDEX_MAX) {
-                            assert(id != 0);
-                            adjacency_lists[prev].insert(id);
-                        }
-                        prev = id;
-                    } else {
-                        // new node
-                        const unsigned long newid = nodes++;
-                        blocks[i].insert({ label, newid });
-                        card += 1;
-                        size += max(label.size(), 1LU);
-                        node_to_block.insert({ newid, i });
-                        adjacency_lists.insert({ newid, unordered_set<unsigned long>() });
-                        if (prev != SEG_INDEX_MAX) {
-                            assert(newid != 0);
-                            adjacency_lists[prev].insert(newid);
-                        }
-                        prev = newid;
-                    }
-                }
+        // threads the sequence through the blocks, adding the nodes and edges it spells
+        auto add_sequence = [&](const string &name, const string &sequence) {
+            assert(sequence.size() == n);
+            vector<unsigned long> path;
+            if (collect_paths)
+                path.reserve(S.size());
 
-                sequence = "";
-            } else if (line[0] == '>' and sequence.length() == 0) {
-                // do nothing
-            } else {
-                sequence += line;
-            }
-        }
-        if (sequence.size() > 0) {
             seg_index prev = SEG_INDEX_MAX;
             for (seg_size_t i = 0; i < S.size(); i++) {
                 assert(S[i].first <= S[i].second);
@@ -120,9 +92,9 @@ namespace eds::block_graph {
                 } else {
                     // new node
                     const unsigned long newid = nodes++;
-                    blocks[i].insert({ label, newid });
                     card += 1;
                     size += max(label.size(), 1LU);
+                    blocks[i].insert({ std::move(label), newid });
                     node_to_block.insert({ newid, i });
                     adjacency_lists.insert({ newid, unordered_set<unsigned long>() });
                     if (prev != SEG_INDEX_MAX) {
@@ -131,10 +103,33 @@ namespace eds::block_graph {
                     }
                     prev = newid;
                 }
+                if (collect_paths)
+                    path.push_back(prev);
             }
+            if (collect_paths)
+                paths.emplace_back(name, std::move(path));
+            EDS_TRACE_COUNT(STRINGS_HASHED, S.size());
+        };
 
+        ifstream msa_if(msa_path);
+        string line = "", sequence = "", name = "";
+        while (getline(msa_if, line)) {
+            if (line.length() == 0) continue;
+            if (line[0] == '>') {
+                if (sequence.length() > 0) {
+                    add_sequence(name, sequence);
+                    sequence = "";
+                }
+                name = line.substr(1, line.find_first_of(" \t") - 1);
+            } else {
+                sequence += line;
+            }
+        }
+        if (sequence.size() > 0) {
+            add_sequence(name, sequence);
             sequence = "";
         }
+        EDS_TRACE_COUNT(BLOCKS_EMITTED, S.size());
 
 #ifdef BLOCK_GRAPH_HPP_DEBUG
         cerr << "DEBUG: blocks are ";
@@ -148,42 +143,263 @@ namespace eds::block_graph {
         cerr << endl;
 #endif
 
-        return { block_graph({ std::move(blocks), std::move(node_to_block), std::move(adjacency_lists) }), card, size };
+        return { block_graph({ std::move(blocks), std::move(node_to_block), std::move(adjacency_lists), std::move(paths) }), card, size };
+    }
+
+    /* node ids of the paths of all rows, kept in a temporary file row by row instead of in
+     * memory: the ids of up to about 16 MiB of blocks are buffered and then written as one run
+     * per row, so that the P lines can be read back sequentially; the file is removed when the
+     * spill goes out of scope */
+    class path_spill {
+    private:
+        string path;
+        std::fstream file;
+        vector<string> names;
+        seg_size_t rows, blocks, capacity;
+        seg_size_t first = 0, buffered = 0; // blocks first..first+buffered-1 are in buffer
+        vector<uint64_t> buffer; // row-major, capacity ids per row
+        bool failed = false;
+
+        void write_buffer() {
+            for (seg_size_t j = 0; j < rows and buffered > 0; j++) {
+                file.seekp((j * blocks + first) * sizeof(uint64_t));
+                file.write(reinterpret_cast<const char *>(buffer.data() + j * capacity), buffered * sizeof(uint64_t));
+            }
+            failed = failed or !file;
+            first += buffered;
+            buffered = 0;
+        }
+
+    public:
+        /* names are the row names of the P lines, blocks the number of segments; capacity
+         * blocks are buffered between writes (0 for about 16 MiB of ids) */
+        path_spill(const string &path, vector<string> names, seg_size_t blocks, seg_size_t capacity = 0)
+            : path(path), file(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc),
+              names(std::move(names)), rows(this->names.size()), blocks(blocks) {
+            if (capacity == 0)
+                capacity = (2 << 20) / std::max<seg_size_t>(1, rows);
+            this->capacity = std::max<seg_size_t>(1, std::min(blocks, capacity));
+            buffer.resize(rows * capacity);
+            failed = !file;
+        }
+        path_spill(const path_spill &) = delete;
+        path_spill &operator=(const path_spill &) = delete;
+        ~path_spill() {
+            file.close();
+            std::remove(path.c_str());
+        }
+
+        bool good() const { return !failed; }
+
+        /* ids[j] is the node of row j in the next block */
+        void add_block(const vector<unsigned long> &ids) {
+            for (seg_size_t j = 0; j < rows; j++)
+                buffer[j * capacity + buffered] = ids[j];
+            if (++buffered == capacity)
+                write_buffer();
+        }
+
+        /* one GFA P line per row, as output_paths; check good() afterwards, the ids may
+         * have failed to be written or read back */
+        void output_paths(buffered_writer &out) {
+            EDS_TRACE_SPAN("output_paths");
+            write_buffer();
+            file.flush();
+            file.seekg(0);
+            vector<uint64_t> ids(capacity);
+            for (seg_size_t j = 0; j < rows and !failed; j++) {
+                out << "P\t" << names[j] << "\t";
+                for (seg_size_t i = 0; i < blocks; i += capacity) {
+                    const seg_size_t n = std::min(capacity, blocks - i);
+                    file.read(reinterpret_cast<char *>(ids.data()), n * sizeof(uint64_t));
+                    failed = failed or !file;
+                    for (seg_size_t k = 0; k < n; k++) {
+                        if (i + k > 0)
+                            out << ',';
+                        out << ids[k] << '+';
+                    }
+                }
+                out << "\t*\n";
+            }
+        }
+    };
+
+    /* block graph built block by block from the row classes of consecutive segments
+     * (see segment_row_classes): node ids of a block are consecutive, one per class, and
+     * edges and paths follow the classes of every row */
+    class class_graph_builder {
+    private:
+        block_graph g;
+        seg_index card = 0, size = 0; // gap-aware size
+        unsigned long nodes = 0;
+        vector<unsigned long> prev;
+        bool collect_paths;
+        path_spill *spill;
+
+    public:
+        /* names are the row names for the paths, collected only if collect_paths is set;
+         * with a spill, the paths go to it instead */
+        class_graph_builder(const vector<string> &names, seg_size_t segments, bool collect_paths, path_spill *spill = nullptr)
+            : prev(names.size()), collect_paths(collect_paths), spill(spill) {
+            g.blocks.reserve(segments);
+            if (collect_paths) {
+                g.paths.resize(names.size());
+                for (seg_size_t j = 0; j < names.size(); j++) {
+                    g.paths[j].first = names[j];
+                    g.paths[j].second.reserve(segments);
+                }
+            }
+        }
+
+        void add_block(const row_classes &classes) {
+            const seg_size_t i = g.blocks.size();
+            g.blocks.emplace_back();
+            g.blocks[i].reserve(classes.labels.size());
+            for (uint32_t k = 0; k < classes.labels.size(); k++) {
+                const unsigned long id = nodes + k;
+                card += 1;
+                size += max(classes.labels[k].size(), 1LU);
+                g.blocks[i].insert({ classes.labels[k], id });
+                g.node_to_block.insert({ id, i });
+                g.adjacency_lists.insert({ id, unordered_set<unsigned long>() });
+            }
+            for (seg_size_t j = 0; j < prev.size(); j++) {
+                const unsigned long id = nodes + classes.class_of[j];
+                if (i > 0)
+                    g.adjacency_lists[prev[j]].insert(id);
+                prev[j] = id;
+                if (collect_paths)
+                    g.paths[j].second.push_back(id);
+            }
+            if (spill != nullptr)
+                spill->add_block(prev);
+            nodes += classes.labels.size();
+            EDS_TRACE_COUNT(BLOCKS_EMITTED, 1);
+        }
+
+        tuple<block_graph,seg_index,seg_index> finish() {
+            return { std::move(g), card, size };
+        }
+    };
+
+    /* requires: as segment_msa, MSA is a column accessor (see column_store.hpp)
+     * returns: the same graph as segment_msa up to node ids, which are given block by block
+     * notes: columns are streamed one segment at a time, or one chunk at a time for segments
+     * longer than msa.chunk_width() (see chunked_row_classes); rows are grouped into integer
+     * classes by segment_row_classes, so nodes and edges are built from class ids and each
+     * label is materialized once; with a spill (for the rows and S.size() blocks) the paths
+     * are written to it instead of collected */
+    template <class MSA>
+    tuple<block_graph,seg_index,seg_index> segment_columns(MSA &msa, const segmentation &S, bool collect_paths = false, path_spill *spill = nullptr) {
+        const seg_index m = msa.rows();
+        assert(S.at(0).first == 1 and S.back().second == msa.columns());
+        EDS_TRACE_SPAN("segment_columns");
+
+        vector<string> names;
+        if (collect_paths)
+            for (seg_index j = 0; j < m; j++)
+                names.push_back(msa.name(j));
+        else
+            names.resize(m);
+        class_graph_builder builder(names, S.size(), collect_paths, spill);
+
+        row_classes classes;
+        std::unordered_multimap<uint64_t, uint32_t> table;
+        for (seg_size_t i = 0; i < S.size(); i++) {
+            assert(S[i].first <= S[i].second);
+            EDS_TRACE_COUNT(COLUMNS, S[i].second - S[i].first + 1);
+            if (S[i].second - S[i].first + 1 <= msa.chunk_width()) {
+                msa.require(S[i].first, S[i].second);
+                segment_row_classes(msa, S[i].first, S[i].second, classes, table);
+            } else {
+                chunked_row_classes(msa, S[i].first, S[i].second, classes, table);
+            }
+            builder.add_block(classes);
+        }
+
+        return builder.finish();
     }
 
-    void output_msa_info(const long long m, const long long n, ofstream &out) {
+    void output_msa_info(const long long m, const long long n, buffered_writer &out) {
         out << "M\t" << m << "\t" << n << "\n";
     }
-    void output_segmentation(const segmentation &S, ofstream &out) {
+    void output_segmentation(const segmentation &S, buffered_writer &out) {
         // 0-indexed to 1-indexed, only starting cols (see xGFAspec.md)
         out << "X";
         for (seg_size_t i = 0; i < S.size() - 1; i++)
             out << "\t" << S[i].first;
         out << "\n";
     }
-    void output_block_info(const block_graph &g, ofstream &out) {
+    /* for a run on MSA columns a..b only: an R line with the region and the start of its last
+     * segment, and the X line of output_segmentation in MSA columns, so that eds-merge can
+     * concatenate the regions into the X line of a run on all of them */
+    void output_region(const seg_index a, const seg_index b, const segmentation &S, buffered_writer &out) {
+        out << "R\t" << a << "\t" << b << "\t" << S.back().first + a - 1 << "\n";
+        out << "X";
+        for (seg_size_t i = 0; i < S.size() - 1; i++)
+            out << "\t" << S[i].first + a - 1;
+        out << "\n";
+    }
+    void output_block_info(const block_graph &g, buffered_writer &out) {
         out << "B";
         for (auto &b : g.blocks)
             out << "\t" << b.size();
         out << "\n";
     }
     /* TODO: rename vertices? */
-    void output_block_graph(const block_graph &g, ofstream &out) {
+    void output_block_graph(const block_graph &g, buffered_writer &out) {
+        EDS_TRACE_SPAN("output_block_graph");
         for (auto &b : g.blocks) {
             for (auto &[label, node] : b) {
-                out << "S\t" << node << "\t" << ((label == "") ? "*" : label) << "\n";
+                out << "S\t" << node << "\t";
+                if (label == "")
+                    out << '*';
+                else
+                    out << label;
+                out << '\n';
                 for (const auto &outneighbor : g.adjacency_lists.at(node)) {
-                    out << "L\t" << node << "\t+\t" << outneighbor << "\t+\t0M" << "\n";
+                    out << "L\t" << node << "\t+\t" << outneighbor << "\t+\t0M\n";
                 }
             }
         }
     }
-    void output_eds(const block_graph &g, ofstream &out) {
+    /* one GFA P line per input sequence, requires paths collected by segment_msa */
+    void output_paths(const block_graph &g, buffered_writer &out) {
+        EDS_TRACE_SPAN("output_paths");
+        for (auto &[name, path] : g.paths) {
+            out << "P\t" << name << "\t";
+            for (seg_size_t i = 0; i < path.size(); i++) {
+                if (i > 0)
+                    out << ',';
+                out << path[i] << '+';
+            }
+            out << "\t*\n";
+        }
+    }
+    /* GFA of the segmented MSA with m rows and n columns, with P lines if paths were
+     * collected or spilled; region_start > 0 marks a run on columns region_start..region_start+n-1 */
+    void output_gfa(const block_graph &g, const long long m, const long long n, const segmentation &S, buffered_writer &out, const seg_index region_start = 0, path_spill *spill = nullptr) {
+        output_msa_info(m, n, out);
+        if (region_start > 0)
+            output_region(region_start, region_start + n - 1, S, out);
+        else
+            output_segmentation(S, out);
+        output_block_info(g, out);
+        output_block_graph(g, out);
+        if (spill != nullptr)
+            spill->output_paths(out);
+        else
+            output_paths(g, out);
+    }
+    void output_eds(const block_graph &g, buffered_writer &out) {
+        EDS_TRACE_SPAN("output_eds");
         for (auto &b : g.blocks) {
             out << "{";
             bool first = true;
             for (auto &[label, _] : b) {
-                out << ((first) ? "" : ",") << label;
+                if (!first)
+                    out << ',';
+                out << label;
                 first = false;
             }
             out << "}";
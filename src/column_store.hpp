@@ -0,0 +1,439 @@
+#ifndef COLUMN_STORE_HPP
+#define COLUMN_STORE_HPP
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "trace.hpp"
+
+/* column access to an MSA, either held in memory or streamed from a column-blocked file
+ * both provide rows(), columns(), name(i), at(i, y) and gapless(i, l, r, out) on 1-indexed
+ * columns, and require(l, r) which must precede access to columns l..r; chunk_width() is the
+ * widest range worth requiring at once, longer ranges are scanned in chunks aligned to it */
+namespace eds::column_store {
+    typedef long long seg_index;
+    const char GAP_CHARACTER = '-';
+    const char MAGIC[8] = { 'E', 'D', 'S', 'C', 'O', 'L', 'S', '1' };
+
+    /* SFINAE guard for templates taking a column accessor, so that overloads on
+     * vector<string> stay preferred for in-memory MSAs */
+    template <class MSA>
+    using requires_column_access = decltype(std::declval<MSA &>().require(1, 1));
+
+    // Multiplication modulo the Mersenne prime 2^61 - 1 for polynomial hashing of gap-free labels
+    const uint64_t HASH_MOD = (1ULL << 61) - 1;
+    const uint64_t HASH_BASE = 1000003;
+    inline uint64_t hash_mul(uint64_t a, uint64_t b) {
+        __uint128_t p = (__uint128_t)a * b;
+        uint64_t s = (uint64_t)(p & HASH_MOD) + (uint64_t)(p >> 61);
+        return (s >= HASH_MOD) ? s - HASH_MOD : s;
+    }
+    inline uint64_t hash_push(uint64_t h, char ch) {
+        uint64_t s = hash_mul(h, HASH_BASE) + (unsigned char)ch + 1;
+        return (s >= HASH_MOD) ? s - HASH_MOD : s;
+    }
+
+    /* MSA rows in memory, optionally with their names; require is a no-op */
+    class in_memory_msa {
+    private:
+        const std::vector<std::string> &msa;
+        const std::vector<std::string> *names;
+
+    public:
+        explicit in_memory_msa(const std::vector<std::string> &msa, const std::vector<std::string> *names = nullptr) : msa(msa), names(names) {}
+        seg_index rows() const { return msa.size(); }
+        seg_index columns() const { return msa[0].size(); }
+        std::string name(seg_index i) const { return (names != nullptr) ? (*names)[i] : "seq" + std::to_string(i + 1); }
+        void require(seg_index, seg_index) {}
+        seg_index chunk_width() const { return columns(); }
+        char at(seg_index i, seg_index y) const { return msa[i][y - 1]; }
+        /* calls f on the characters of row i in columns l..r */
+        template <class F>
+        void scan(seg_index i, seg_index l, seg_index r, F &&f) const {
+            for (const char *p = msa[i].data() + l - 1, *end = msa[i].data() + r; p != end; ++p)
+                f(*p);
+        }
+        void gapless(seg_index i, seg_index l, seg_index r, std::string &out) const {
+            out.clear();
+            scan(i, l, r, [&](char ch) { if (ch != GAP_CHARACTER) out.push_back(ch); });
+        }
+    };
+
+    /* file layout: MAGIC, rows, columns, block width (uint64 each), row names (uint64 length
+     * and bytes each), then the blocks of block-width columns, each storing the slices of
+     * all rows one after another */
+    struct column_file_header {
+        uint64_t rows = 0, columns = 0, block_width = 0;
+        std::vector<std::string> names;
+        uint64_t data_offset = 0;
+    };
+
+    namespace detail {
+        inline void write_u64(std::ofstream &out, uint64_t v) { out.write(reinterpret_cast<const char *>(&v), sizeof(v)); }
+        inline uint64_t read_u64(std::ifstream &in) { uint64_t v = 0; in.read(reinterpret_cast<char *>(&v), sizeof(v)); return v; }
+    }
+
+    /* about 16 MiB per block, and at least 1024 columns */
+    inline uint64_t default_block_width(uint64_t rows) {
+        return std::max<uint64_t>(1024, (16 << 20) / rows);
+    }
+
+    /* converts a FASTA MSA into a column-blocked file in two streaming passes, holding one
+     * block-width slice of one row at a time; block_width 0 picks about 16 MiB per block
+     * returns: false if the FASTA is empty or its rows have different lengths */
+    bool convert_fasta(const std::string &fasta_path, const std::string &out_path, uint64_t block_width = 0) {
+        EDS_TRACE_SPAN("convert_fasta");
+        column_file_header h;
+        {
+            std::ifstream in(fasta_path);
+            std::string line;
+            uint64_t length = 0;
+            bool in_sequence = false;
+            auto end_sequence = [&]() {
+                if (!in_sequence) return true;
+                if (h.rows == 1) h.columns = length;
+                return length == h.columns;
+            };
+            while (std::getline(in, line)) {
+                if (line.empty()) continue;
+                if (line[0] == '>') {
+                    if (!end_sequence()) return false;
+                    h.names.push_back(line.substr(1, line.find_first_of(" \t") - 1));
+                    h.rows += 1;
+                    length = 0;
+                    in_sequence = true;
+                } else {
+                    length += line.size();
+                }
+            }
+            if (!end_sequence() or h.rows == 0 or h.columns == 0) return false;
+        }
+        h.block_width = (block_width > 0) ? block_width : default_block_width(h.rows);
+
+        std::ofstream out(out_path, std::ios::binary | std::ios::trunc);
+        out.write(MAGIC, sizeof(MAGIC));
+        detail::write_u64(out, h.rows);
+        detail::write_u64(out, h.columns);
+        detail::write_u64(out, h.block_width);
+        for (auto &name : h.names) {
+            detail::write_u64(out, name.size());
+            out.write(name.data(), name.size());
+        }
+        h.data_offset = out.tellp();
+
+        std::ifstream in(fasta_path);
+        std::string line, slice;
+        slice.reserve(h.block_width);
+        int64_t row = -1;
+        uint64_t column = 0; // columns of the current row read so far
+        auto flush_slice = [&]() {
+            const uint64_t block = (column - 1) / h.block_width;
+            const uint64_t width = std::min(h.block_width, h.columns - block * h.block_width);
+            out.seekp(h.data_offset + block * h.rows * h.block_width + row * width);
+            out.write(slice.data(), slice.size());
+            slice.clear();
+        };
+        while (std::getline(in, line)) {
+            if (line.empty()) continue;
+            if (line[0] == '>') {
+                row += 1;
+                column = 0;
+                continue;
+            }
+            for (const char ch : line) {
+                slice.push_back(ch);
+                column += 1;
+                if (column % h.block_width == 0 or column == h.columns)
+                    flush_slice();
+            }
+        }
+        return out.good();
+    }
+
+    /* sliding window over a column-blocked file: keeps the blocks overlapping the last
+     * required column range in memory and reads the next block in the background */
+    class column_window {
+    private:
+        struct block {
+            uint64_t index, width;
+            std::vector<char> data;
+        };
+
+        std::ifstream in;
+        column_file_header h;
+        uint64_t blocks = 0;
+        std::deque<block> resident; // consecutive blocks
+        std::future<block> prefetch;
+        std::atomic<bool> failed{ false }; // not a complete column file, or a block could not be read whole
+
+        block read_block(uint64_t index) {
+            block b;
+            b.index = index;
+            b.width = std::min(h.block_width, h.columns - index * h.block_width);
+            b.data.resize(h.rows * b.width);
+            in.seekg(h.data_offset + index * h.rows * h.block_width);
+            in.read(b.data.data(), b.data.size());
+            if ((uint64_t)in.gcount() != b.data.size())
+                failed = true;
+            return b;
+        }
+
+        block load(uint64_t index) {
+            if (prefetch.valid()) {
+                block b = prefetch.get();
+                if (b.index == index)
+                    return b;
+            }
+            return read_block(index);
+        }
+
+        const block &block_of(seg_index y) const {
+            return resident[(y - 1) / h.block_width - resident.front().index];
+        }
+
+    public:
+        explicit column_window(const std::string &path) : in(path, std::ios::binary) {
+            char magic[sizeof(MAGIC)] = { 0 };
+            in.read(magic, sizeof(magic));
+            if (!in or !std::equal(magic, magic + sizeof(MAGIC), MAGIC)) {
+                failed = true;
+                return;
+            }
+            h.rows = detail::read_u64(in);
+            h.columns = detail::read_u64(in);
+            h.block_width = detail::read_u64(in);
+            h.names.resize(h.rows);
+            for (auto &name : h.names) {
+                name.resize(detail::read_u64(in));
+                in.read(name.data(), name.size());
+            }
+            h.data_offset = in.tellg();
+            if (!in or h.rows == 0 or h.columns == 0 or h.block_width == 0) {
+                failed = true;
+                return;
+            }
+            blocks = (h.columns + h.block_width - 1) / h.block_width;
+            // a truncated file fails here rather than with blocks of zeros
+            in.seekg(0, std::ios::end);
+            if (!in or (uint64_t)in.tellg() < h.data_offset + h.rows * h.columns)
+                failed = true;
+        }
+
+        ~column_window() {
+            if (prefetch.valid())
+                prefetch.wait();
+        }
+
+        /* false if the file is not a complete column file, or a block could not be read */
+        bool good() const { return !failed; }
+        seg_index rows() const { return h.rows; }
+        seg_index columns() const { return h.columns; }
+        seg_index block_width() const { return h.block_width; }
+        seg_index chunk_width() const { return h.block_width; }
+        const std::string &name(seg_index i) const { return h.names[i]; }
+
+        /* makes columns l..r resident, dropping blocks before column l; moving the window
+         * backwards restarts the scan */
+        void require(seg_index l, seg_index r) {
+            assert(1 <= l and l <= r and r <= (seg_index)h.columns);
+            const uint64_t first = (l - 1) / h.block_width, last = (r - 1) / h.block_width;
+            if (!resident.empty() and (first < resident.front().index or first > resident.back().index + 1))
+                resident.clear();
+            while (!resident.empty() and resident.front().index < first)
+                resident.pop_front();
+            if (!resident.empty() and resident.back().index >= last)
+                return;
+
+            uint64_t next = (resident.empty()) ? first : resident.back().index + 1;
+            for (; next <= last; next++)
+                resident.push_back(load(next));
+            if (next < blocks and !prefetch.valid()) {
+                prefetch = std::async(std::launch::async, [this, next]() { return read_block(next); });
+            }
+        }
+
+        char at(seg_index i, seg_index y) const {
+            const block &b = block_of(y);
+            return b.data[i * b.width + (y - 1) - b.index * h.block_width];
+        }
+
+        template <class F>
+        void scan(seg_index i, seg_index l, seg_index r, F &&f) const {
+            for (seg_index y = l; y <= r; ) {
+                const block &b = block_of(y);
+                const seg_index block_end = std::min<seg_index>(r, (b.index + 1) * h.block_width);
+                const char *p = b.data.data() + i * b.width + (y - 1) - b.index * h.block_width;
+                for (const char *end = p + (block_end - y + 1); p != end; ++p)
+                    f(*p);
+                y = block_end + 1;
+            }
+        }
+
+        void gapless(seg_index i, seg_index l, seg_index r, std::string &out) const {
+            out.clear();
+            scan(i, l, r, [&](char ch) { if (ch != GAP_CHARACTER) out.push_back(ch); });
+        }
+    };
+
+    /* rows grouped by their gap-free label in columns l..r: class_of[i] is the class of row i,
+     * classes are numbered by first row, and labels[k] is the one label materialized for class k */
+    struct row_classes {
+        std::vector<uint32_t> class_of;
+        std::vector<std::string> labels;
+    };
+
+    /* classes are found by rolling hashes of the gap-free labels, and every row is verified
+     * against the label of its class, so hash collisions cannot merge different labels
+     * table is scratch space kept between calls */
+    template <class MSA>
+    void segment_row_classes(const MSA &msa, seg_index l, seg_index r, row_classes &classes, std::unordered_multimap<uint64_t, uint32_t> &table) {
+        const seg_index m = msa.rows();
+        classes.class_of.resize(m);
+        classes.labels.clear();
+        table.clear();
+        EDS_TRACE_COUNT(STRINGS_HASHED, m);
+        for (seg_index i = 0; i < m; i++) {
+            uint64_t hash = 0;
+            msa.scan(i, l, r, [&](char ch) { if (ch != GAP_CHARACTER) hash = hash_push(hash, ch); });
+
+            bool found = false;
+            auto [first, last] = table.equal_range(hash);
+            for (auto it = first; it != last and !found; ++it) {
+                const std::string &label = classes.labels[it->second];
+                std::size_t pos = 0;
+                bool equal = true;
+                msa.scan(i, l, r, [&](char ch) {
+                    if (ch == GAP_CHARACTER) return;
+                    equal = equal and pos < label.size() and label[pos] == ch;
+                    pos += 1;
+                });
+                if (equal and pos == label.size()) {
+                    classes.class_of[i] = it->second;
+                    found = true;
+                }
+            }
+            if (!found) {
+                const uint32_t k = classes.labels.size();
+                classes.labels.emplace_back();
+                msa.gapless(i, l, r, classes.labels.back());
+                table.insert({ hash, k });
+                classes.class_of[i] = k;
+            }
+        }
+    }
+
+    /* as segment_row_classes on columns l..r, requiring them one chunk of msa.chunk_width()
+     * columns at a time, so that a long (perfect) segment does not become resident whole
+     * notes: the rolling hash and gap-free length of every row are carried across chunks;
+     * labels of the first row of each candidate class are built in a second pass, and the
+     * other rows are verified against them in a third, with rows that collide moved to
+     * another class and the passes repeated for them */
+    template <class MSA>
+    void chunked_row_classes(MSA &msa, seg_index l, seg_index r, row_classes &classes, std::unordered_multimap<uint64_t, uint32_t> &table) {
+        const seg_index m = msa.rows(), w = msa.chunk_width();
+        auto for_chunks = [&](auto &&f) {
+            for (seg_index a = l; a <= r; ) {
+                const seg_index b = std::min(r, ((a - 1) / w + 1) * w);
+                msa.require(a, b);
+                f(a, b);
+                a = b + 1;
+            }
+        };
+        EDS_TRACE_COUNT(STRINGS_HASHED, m);
+
+        std::vector<uint64_t> hash(m, 0), length(m, 0);
+        for_chunks([&](seg_index a, seg_index b) {
+            for (seg_index i = 0; i < m; i++)
+                msa.scan(i, a, b, [&](char ch) {
+                    if (ch == GAP_CHARACTER) return;
+                    hash[i] = hash_push(hash[i], ch);
+                    length[i] += 1;
+                });
+        });
+
+        std::vector<seg_index> first_row; // of each class
+        std::vector<std::vector<uint32_t>> rejected(m); // classes row i turned out to differ from
+        std::vector<seg_index> open(m), position(m);
+        for (seg_index i = 0; i < m; i++)
+            open[i] = i;
+        classes.class_of.resize(m);
+        classes.labels.clear();
+        table.clear();
+        while (!open.empty()) {
+            // candidate class by hash and length, or a new class whose label is to be built
+            std::vector<seg_index> unbuilt, unverified;
+            for (const seg_index i : open) {
+                bool found = false;
+                auto [first, last] = table.equal_range(hash[i]);
+                for (auto it = first; it != last and !found; ++it) {
+                    const uint32_t k = it->second;
+                    if (length[first_row[k]] == length[i] and std::find(rejected[i].begin(), rejected[i].end(), k) == rejected[i].end()) {
+                        classes.class_of[i] = k;
+                        found = true;
+                    }
+                }
+                if (found) {
+                    unverified.push_back(i);
+                } else {
+                    const uint32_t k = first_row.size();
+                    first_row.push_back(i);
+                    classes.labels.emplace_back();
+                    classes.labels.back().reserve(length[i]);
+                    table.insert({ hash[i], k });
+                    classes.class_of[i] = k;
+                    unbuilt.push_back(i);
+                }
+            }
+            for_chunks([&](seg_index a, seg_index b) {
+                for (const seg_index i : unbuilt)
+                    msa.scan(i, a, b, [&](char ch) { if (ch != GAP_CHARACTER) classes.labels[classes.class_of[i]].push_back(ch); });
+            });
+
+            open.clear();
+            if (unverified.empty())
+                break;
+            std::vector<char> equal(m, true);
+            for (const seg_index i : unverified)
+                position[i] = 0;
+            for_chunks([&](seg_index a, seg_index b) {
+                for (const seg_index i : unverified) {
+                    const std::string &label = classes.labels[classes.class_of[i]];
+                    msa.scan(i, a, b, [&](char ch) {
+                        if (ch == GAP_CHARACTER) return;
+                        equal[i] = equal[i] and label[position[i]] == ch;
+                        position[i] += 1;
+                    });
+                }
+            });
+            for (const seg_index i : unverified) {
+                if (!equal[i]) {
+                    rejected[i].push_back(classes.class_of[i]);
+                    open.push_back(i);
+                }
+            }
+        }
+
+        // classes numbered by first row, as segment_row_classes does
+        std::vector<uint32_t> renumber(first_row.size(), UINT32_MAX);
+        std::vector<std::string> labels(first_row.size());
+        uint32_t next = 0;
+        for (seg_index i = 0; i < m; i++) {
+            uint32_t &k = renumber[classes.class_of[i]];
+            if (k == UINT32_MAX) {
+                k = next++;
+                labels[k] = std::move(classes.labels[classes.class_of[i]]);
+            }
+            classes.class_of[i] = k;
+        }
+        classes.labels = std::move(labels);
+    }
+} // namespace eds::column_store
+#endif // COLUMN_STORE_HPP
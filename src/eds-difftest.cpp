@@ -0,0 +1,612 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <set>
+#include <algorithm>
+#include <random>
+#include <filesystem>
+#include <limits>
+#include <sstream>
+#include <unistd.h>
+
+#include "block_graph.hpp"
+#include "mincard.hpp"
+#include "column_store.hpp"
+#include "eds_query.hpp"
+#include "incremental.hpp"
+#include "fasta_index.hpp"
+#include "region_merge.hpp"
+#include "batch.hpp"
+
+using namespace std;
+using eds::block_graph::block_graph, eds::block_graph::segment_msa, eds::block_graph::segment_columns;
+using eds::mincard::read_fasta, eds::mincard::compute_meaningful_extensions, eds::mincard::compute_perfect_columns, eds::mincard::segment_with_rmq, eds::mincard::segment_greedy, eds::mincard::streaming_extensions, eds::mincard::card_eds;
+using eds::column_store::column_window, eds::column_store::convert_fasta, eds::column_store::in_memory_msa;
+using eds::io::buffered_writer;
+using eds::mincard::objective;
+
+typedef eds::block_graph::seg_index seg_index;
+typedef vector<pair<seg_index, seg_index>> segmentation;
+
+// Differential tests: every optimized code path is checked against a brute-force reference
+// on many small random MSAs (or on the given FASTA files, e.g. produced by dna2msa with seeds).
+
+string context; // describes the current MSA and parameters for failure reports
+size_t checks = 0, failures = 0;
+
+void check(bool ok, const string& what) {
+    checks += 1;
+    if (ok) return;
+    failures += 1;
+    cerr << "FAILED: " << what << "\n" << context << endl;
+}
+
+// Random MSA whose rows derive from one ancestor, so that rows share labels and gap patterns
+vector<string> random_msa(std::mt19937& rng) {
+    const seg_index r = 1 + rng() % 7, c = 1 + rng() % 30;
+    const double mutation = (rng() % 4) * 0.1, gap = (rng() % 4) * 0.15;
+    std::uniform_real_distribution<> coin(0.0, 1.0);
+    const string alphabet = "ACGT";
+
+    string ancestor(c, 'A');
+    for (auto& ch : ancestor)
+        ch = (coin(rng) < gap) ? '-' : alphabet[rng() % 4];
+    vector<string> msa(r, ancestor);
+    for (seg_index i = 1; i < r; ++i) {
+        const string& parent = msa[rng() % i];
+        for (seg_index y = 0; y < c; ++y) {
+            msa[i][y] = parent[y];
+            if (coin(rng) < mutation)
+                msa[i][y] = (coin(rng) < gap) ? '-' : alphabet[rng() % 4];
+        }
+    }
+    return msa;
+}
+
+// rows on one line, or wrapped at line_width columns
+void write_fasta(const string& filename, const vector<string>& msa, size_t line_width = 0) {
+    ofstream out(filename);
+    for (size_t i = 0; i < msa.size(); ++i) {
+        out << ">seq" << i + 1 << " row " << i + 1 << "\n";
+        for (size_t y = 0; y < msa[i].size(); y += (line_width > 0) ? line_width : msa[i].size())
+            out << msa[i].substr(y, (line_width > 0) ? line_width : string::npos) << "\n";
+    }
+}
+
+// cost of the labels of columns l..r under the objective (the height by default)
+seg_index height(const vector<string>& msa, seg_index l, seg_index r, const objective& obj = objective()) {
+    set<string> labels;
+    for (const auto& row : msa) {
+        string s = row.substr(l - 1, r - l + 1);
+        s.erase(remove(s.begin(), s.end(), '-'), s.end());
+        labels.insert(s);
+    }
+    seg_index size = 0;
+    for (const auto& label : labels)
+        size += max<seg_index>(label.size(), 1);
+    return obj.cost(labels.size(), size);
+}
+
+// O(c·U) DP evaluating every segment of length at most U, and every run of perfect columns
+seg_index brute_force_mincard(const vector<string>& msa, seg_index U, const vector<bool>& perfect_columns, const objective& obj = objective()) {
+    const seg_index c = msa[0].size();
+    const seg_index INF = numeric_limits<seg_index>::max();
+    vector<seg_index> m(c + 1, INF);
+    m[0] = 0;
+    for (seg_index y = 1; y <= c; ++y) {
+        for (seg_index len = 1; len <= U and len <= y; ++len)
+            m[y] = min(m[y], m[y - len] + height(msa, y - len + 1, y, obj));
+        for (seg_index x = y; !perfect_columns.empty() and x >= 1 and perfect_columns[x]; --x)
+            m[y] = min(m[y], m[x - 1] + height(msa, x, y, obj));
+    }
+    return m[c];
+}
+
+bool valid_segmentation(const segmentation& S, seg_index c, seg_index U, const vector<bool>& perfect_columns) {
+    seg_index next = 1;
+    for (auto [l, r] : S) {
+        if (l != next or r < l) return false;
+        bool perfect = !perfect_columns.empty();
+        for (seg_index y = l; perfect and y <= r; ++y)
+            perfect = perfect_columns[y];
+        if (r - l + 1 > U and !perfect) return false;
+        next = r + 1;
+    }
+    return next == c + 1;
+}
+
+// labels of every block, sorted, to compare graphs whose node ids differ
+vector<vector<string>> canonical_eds(const block_graph& g) {
+    vector<vector<string>> blocks;
+    for (auto& b : g.blocks) {
+        blocks.emplace_back();
+        for (auto& [label, _] : b)
+            blocks.back().push_back(label);
+        sort(blocks.back().begin(), blocks.back().end());
+    }
+    return blocks;
+}
+
+// edges as label pairs between consecutive blocks
+set<tuple<size_t, string, string>> canonical_edges(const block_graph& g) {
+    vector<string> label_of;
+    for (auto& b : g.blocks)
+        for (auto& [label, node] : b) {
+            if (label_of.size() <= node) label_of.resize(node + 1);
+            label_of[node] = label;
+        }
+    set<tuple<size_t, string, string>> edges;
+    for (auto& [node, out] : g.adjacency_lists)
+        for (auto v : out)
+            edges.insert({ g.node_to_block.at(node), label_of[node], label_of[v] });
+    return edges;
+}
+
+// every path as the labels it spells
+vector<pair<string, vector<string>>> path_labels(const block_graph& g) {
+    unordered_map<unsigned long, string> label_of;
+    for (auto& b : g.blocks)
+        for (auto& [label, node] : b)
+            label_of[node] = label;
+    vector<pair<string, vector<string>>> paths;
+    for (auto& [name, path] : g.paths) {
+        paths.emplace_back(name, vector<string>());
+        for (auto node : path)
+            paths.back().second.push_back(label_of.at(node));
+    }
+    return paths;
+}
+
+// pattern occurs in some string of the EDS language, by enumerating the language
+bool occurs_naive(const vector<vector<string>>& eds, const string& pattern, size_t b = 0, const string& prefix = "") {
+    if (b == eds.size())
+        return prefix.find(pattern) != string::npos;
+    for (const auto& label : eds[b]) {
+        string s = prefix + label;
+        if (s.find(pattern) != string::npos) return true;
+        // only the last |pattern| - 1 characters can take part in a later occurrence
+        if (s.size() >= pattern.size()) s = s.substr(s.size() - pattern.size() + 1);
+        if (occurs_naive(eds, pattern, b + 1, s)) return true;
+    }
+    return false;
+}
+
+void check_query_engine(const block_graph& g, std::mt19937& rng) {
+    auto eds = canonical_eds(g);
+    double language = 1;
+    for (auto& b : eds) language *= b.size();
+    if (language > 4096) return;
+
+    auto compact = eds::query::compact(g);
+    vector<string> patterns;
+    for (int k = 0; k < 8; ++k) {
+        string p(1 + rng() % 6, 'A');
+        for (auto& ch : p) ch = "ACGT"[rng() % 4];
+        patterns.push_back(p);
+    }
+    auto results = eds::query::match_all(compact, patterns, 2);
+    for (size_t k = 0; k < patterns.size(); ++k)
+        check((results[k].occurrences > 0) == occurs_naive(eds, patterns[k]), "Shift-And query of " + patterns[k] + " against enumeration of the EDS language");
+}
+
+// region runs as msa2eds-mincard --region writes them, merged by eds-merge: the merged paths
+// spell the rows along edges of the merged graph, and the regions keep their segmentations
+void check_region_merge(const vector<string>& msa, seg_index U, bool allow_perfect_segments, const string& tmp, std::mt19937& rng) {
+    const seg_index c = msa[0].size();
+    if (c < 2) return;
+    const seg_index split = 1 + rng() % (c - 1);
+    vector<string> names, inputs, eds_inputs;
+    string eds_text;
+    for (size_t i = 0; i < msa.size(); ++i) names.push_back("seq" + to_string(i + 1));
+    vector<seg_index> starts;
+    segmentation whole;
+    seg_index card = 0;
+    for (auto [a, b] : { pair<seg_index, seg_index>(1, split), pair<seg_index, seg_index>(split + 1, c) }) {
+        vector<string> region;
+        for (const auto& row : msa) region.push_back(row.substr(a - 1, b - a + 1));
+        vector<bool> perfect_columns = {};
+        if (allow_perfect_segments)
+            perfect_columns = compute_perfect_columns(region).second;
+        auto L_y = compute_meaningful_extensions(region, 1, U);
+        auto segments = segment_with_rmq(L_y, b - a + 1, perfect_columns).second;
+        in_memory_msa rows(region, &names);
+        auto [g, region_card, _] = segment_columns(rows, segments, true);
+        card += region_card;
+        for (auto [l, r] : segments) {
+            starts.push_back(l + a - 1);
+            whole.push_back({ l + a - 1, r + a - 1 });
+        }
+        inputs.push_back(tmp + "." + to_string(a) + "-" + to_string(b) + ".gfa");
+        buffered_writer out(inputs.back());
+        eds::block_graph::output_msa_info(msa.size(), b - a + 1, out);
+        eds::block_graph::output_region(a, b, segments, out);
+        eds::block_graph::output_block_info(g, out);
+        eds::block_graph::output_block_graph(g, out);
+        eds::block_graph::output_paths(g, out);
+        eds_inputs.push_back(tmp + "." + to_string(a) + "-" + to_string(b) + ".eds");
+        string text;
+        {
+            buffered_writer eds_out(&text);
+            eds::block_graph::output_eds(g, eds_out);
+        }
+        std::ofstream(eds_inputs.back()) << text;
+        eds_text += text.substr(0, text.size() - 1);
+    }
+    string error;
+    {
+        // EDS regions are pasted in column order, and only under the names of their region runs
+        string merged;
+        buffered_writer out(&merged);
+        check(eds::region_merge::merge_eds(eds_inputs, out, error), "merge_eds succeeds: " + error);
+        out.close();
+        check(merged == eds_text + "\n", "merge_eds concatenates the blocks of the regions");
+        check(!eds::region_merge::merge_eds({ eds_inputs[1], eds_inputs[0] }, out, error), "merge_eds rejects regions out of column order");
+        check(!eds::region_merge::merge_eds({ eds_inputs[0], eds_inputs[0] }, out, error), "merge_eds rejects a repeated region");
+        std::filesystem::copy_file(eds_inputs[1], tmp + ".renamed.eds", std::filesystem::copy_options::overwrite_existing);
+        check(!eds::region_merge::merge_eds({ eds_inputs[0], tmp + ".renamed.eds" }, out, error), "merge_eds rejects a region without its .a-b.eds name");
+        std::filesystem::remove(tmp + ".renamed.eds");
+        std::filesystem::copy_file(inputs[1], tmp + ".gfa-as-eds");
+        std::filesystem::rename(tmp + ".gfa-as-eds", eds_inputs[1]);
+        check(!eds::region_merge::merge_eds(eds_inputs, out, error), "merge_eds rejects a GFA region");
+        std::ofstream(eds_inputs[1]) << "{A}{C}\n{G}\n";
+        check(!eds::region_merge::merge_eds(eds_inputs, out, error), "merge_eds rejects an EDS of more than one line");
+        std::ofstream(eds_inputs[1]) << "{A}C{G}\n";
+        check(!eds::region_merge::merge_eds(eds_inputs, out, error), "merge_eds rejects text between blocks");
+        for (auto& input : eds_inputs) std::filesystem::remove(input);
+    }
+    {
+        // malformed or truncated regions are reported, not thrown on
+        ifstream in(inputs[0]);
+        string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        const size_t s_line = text.find("\nS\t") + 3;
+        std::ofstream(tmp + ".bad.gfa") << text.substr(0, s_line) << "x" << text.substr(s_line);
+        eds::region_merge::region_gfa bad;
+        check(!eds::region_merge::read_region_gfa(tmp + ".bad.gfa", bad, error) and error.find("malformed S line") != string::npos, "read_region_gfa reports a malformed node id");
+        std::ofstream(tmp + ".bad.gfa") << text.substr(0, text.size() / 2);
+        buffered_writer out(tmp + ".merged.gfa");
+        check(!eds::region_merge::merge_gfa({ tmp + ".bad.gfa", inputs[1] }, out, error), "merge_gfa rejects a truncated region");
+        std::filesystem::remove(tmp + ".bad.gfa");
+    }
+    {
+        // a region written with --no-paths leaves the junctions unknown, so it is not merged
+        ifstream in(inputs[1]);
+        std::ofstream no_paths(tmp + ".no-paths.gfa");
+        string line;
+        while (getline(in, line))
+            if (line[0] != 'P') no_paths << line << "\n";
+        no_paths.close();
+        buffered_writer out(tmp + ".merged.gfa");
+        check(!eds::region_merge::merge_gfa({ inputs[0], tmp + ".no-paths.gfa" }, out, error), "merge_gfa rejects a region without P lines");
+        std::filesystem::remove(tmp + ".no-paths.gfa");
+    }
+    {
+        buffered_writer out(tmp + ".merged.gfa");
+        check(eds::region_merge::merge_gfa(inputs, out, error), "merge_gfa succeeds: " + error);
+    }
+
+    eds::region_merge::region_gfa merged;
+    check(eds::region_merge::read_region_gfa(tmp + ".merged.gfa", merged, error), "merged GFA is a region GFA: " + error);
+    check(merged.a == 1 and merged.b == c and merged.starts == starts and merged.nodes == (unsigned long)card, "merged GFA covers both regions and keeps their segments and nodes");
+    {
+        // up to its R line and the order of its lines, the merged GFA is that of a run on all columns
+        in_memory_msa rows(msa, &names);
+        auto [g, whole_card, _] = segment_columns(rows, whole, true);
+        string expected;
+        {
+            buffered_writer out(&expected);
+            eds::block_graph::output_gfa(g, msa.size(), c, whole, out);
+        }
+        std::multiset<string> expected_lines, merged_lines;
+        std::istringstream expected_in(expected);
+        ifstream merged_in(tmp + ".merged.gfa");
+        string line;
+        while (getline(expected_in, line)) expected_lines.insert(line);
+        while (getline(merged_in, line))
+            if (line[0] != 'R') merged_lines.insert(line);
+        check(merged_lines == expected_lines, "merged GFA equals the GFA of the concatenated segmentation");
+    }
+    unordered_map<unsigned long, string> label_of;
+    set<pair<unsigned long, unsigned long>> edges;
+    ifstream in(tmp + ".merged.gfa");
+    string line;
+    while (getline(in, line)) {
+        auto fields = eds::region_merge::detail::split(line, '\t');
+        if (fields[0] == "S") label_of[stoul(fields[1])] = (fields[2] == "*") ? "" : fields[2];
+        if (fields[0] == "L") edges.insert({ stoul(fields[1]), stoul(fields[3]) });
+    }
+    check(merged.paths.size() == msa.size(), "merged GFA has one path per row");
+    for (size_t i = 0; i < merged.paths.size() and i < msa.size(); ++i) {
+        string spelled, row = msa[i];
+        row.erase(remove(row.begin(), row.end(), '-'), row.end());
+        bool along_edges = true;
+        auto& path = merged.paths[i].second;
+        for (size_t k = 0; k < path.size(); ++k) {
+            spelled += label_of[path[k]];
+            along_edges = along_edges and (k == 0 or edges.count({ path[k - 1], path[k] }) > 0);
+        }
+        check(merged.paths[i].first == names[i] and spelled == row and along_edges, "merged path of " + names[i] + " spells its row along edges");
+    }
+    for (auto& input : inputs) std::filesystem::remove(input);
+    std::filesystem::remove(tmp + ".merged.gfa");
+}
+
+void test_msa(const vector<string>& msa, const string& description, std::mt19937& rng) {
+    const string tmp = (std::filesystem::temp_directory_path() / ("eds-difftest-" + to_string(getpid()) + ".fasta")).string();
+    write_fasta(tmp, msa);
+    const seg_index c = msa[0].size();
+
+    // .fai random access against the rows, on a copy wrapped at a random line width
+    vector<eds::fasta_index::fai_record> records;
+    write_fasta(tmp + ".wrapped", msa, 1 + rng() % 7);
+    context = description + "\n";
+    check(eds::fasta_index::build_index(tmp + ".wrapped", records) and records.size() == msa.size(), "build_index indexes every row");
+    for (int k = 0; k < 4 and records.size() == msa.size(); ++k) {
+        const seg_index a = 1 + rng() % c, b = a + rng() % (c - a + 1);
+        auto region = eds::fasta_index::read_region(tmp + ".wrapped", records, a, b);
+        bool equal = true;
+        for (size_t i = 0; i < msa.size(); ++i)
+            equal = equal and records[i].name == "seq" + to_string(i + 1) and region[i] == msa[i].substr(a - 1, b - a + 1);
+        check(equal, "read_region " + to_string(a) + "-" + to_string(b) + " equals the columns of the rows");
+    }
+    if (records.size() == msa.size()) {
+        std::filesystem::resize_file(tmp + ".wrapped", records.back().offset);
+        check(eds::fasta_index::read_region(tmp + ".wrapped", records, 1, c).empty(), "read_region returns no rows from a FASTA shorter than its index");
+    }
+    {
+        // an empty line ends a record like a shorter line does, so more sequence after it is rejected
+        ofstream out(tmp + ".wrapped");
+        out << ">a\nACGT\n\nAC\n>b\nAC-T\n\nGG\n";
+    }
+    check(!eds::fasta_index::build_index(tmp + ".wrapped", records), "build_index rejects sequence lines after an empty line");
+    std::filesystem::remove(tmp + ".wrapped");
+
+    for (seg_index U : { (seg_index)1, (seg_index)2, (seg_index)3, (seg_index)5, c }) {
+        for (bool allow_perfect_segments : { false, true }) {
+            context = description + ", U = " + to_string(U) + ", allow-perfect-segments = " + to_string(allow_perfect_segments) + "\n";
+            for (const auto& row : msa) context += "  " + row + "\n";
+
+            vector<bool> perfect_columns = {};
+            if (allow_perfect_segments)
+                perfect_columns = compute_perfect_columns(msa).second;
+
+            // RMQ DP against brute force
+            auto L_y = compute_meaningful_extensions(msa, 1, U);
+            auto [cost, segments] = segment_with_rmq(L_y, c, perfect_columns);
+            check(cost == brute_force_mincard(msa, U, perfect_columns), "segment_with_rmq cost equals the brute-force DP");
+            check(valid_segmentation(segments, c, U, perfect_columns), "segment_with_rmq returns a valid segmentation");
+            check(card_eds(msa, segments) == cost, "card_eds of the DP segmentation equals its cost");
+
+            auto [g, card, size] = segment_msa(tmp, c, segments, true);
+            check(card == cost, "segment_msa cardinality equals the DP cost");
+            check(g.paths.size() == msa.size(), "segment_msa collects one path per sequence");
+
+            // block graph from integer row classes against the label-hashing reference
+            in_memory_msa rows(msa);
+            auto [classed, classed_card, classed_size] = segment_columns(rows, segments, true);
+            check(classed_card == card and classed_size == size, "segment_columns cardinality and size equal segment_msa");
+            check(canonical_eds(classed) == canonical_eds(g) and canonical_edges(classed) == canonical_edges(g), "segment_columns graph equals segment_msa");
+            check(path_labels(classed) == path_labels(g), "segment_columns paths spell the same labels as segment_msa");
+
+            // greedy: valid, never below the optimum, and its cardinality estimate is exact here
+            auto [greedy_card, greedy_segments] = segment_greedy(msa, U, perfect_columns);
+            check(valid_segmentation(greedy_segments, c, U, perfect_columns), "segment_greedy returns a valid segmentation");
+            check(greedy_card >= cost, "segment_greedy is not below the optimum");
+            check(card_eds(msa, greedy_segments) == greedy_card, "segment_greedy cardinality equals card_eds");
+
+            // out-of-core backend against the in-memory one, with blocks narrower and wider than U
+            for (seg_index block_width : { (seg_index)1, (seg_index)3, c + 1 }) {
+                check(convert_fasta(tmp, tmp + ".cols", block_width), "convert_fasta succeeds");
+                column_window window(tmp + ".cols");
+                auto [window_perfect, window_perfect_columns] = compute_perfect_columns(window);
+                check(!allow_perfect_segments or window_perfect_columns == perfect_columns, "streamed perfect columns equal the in-memory ones");
+                streaming_extensions<column_window> streamed(window, 1, U);
+                auto [streamed_cost, streamed_segments] = segment_with_rmq(streamed, c, perfect_columns);
+                check(streamed_cost == cost and streamed_segments == segments, "streamed DP equals the in-memory DP");
+                check(segment_greedy(window, U, perfect_columns).second == greedy_segments, "streamed greedy equals the in-memory greedy");
+                auto [h, streamed_card, streamed_size] = segment_columns(window, segments, true);
+                check(streamed_card == card and streamed_size == size, "segment_columns cardinality and size equal segment_msa");
+                check(canonical_eds(h) == canonical_eds(g) and canonical_edges(h) == canonical_edges(g), "segment_columns graph equals segment_msa");
+                check(path_labels(h) == path_labels(g), "streamed segment_columns paths spell the same labels as segment_msa");
+                {
+                    // P lines spilled to a file, with runs of 2 blocks per row, equal the collected ones
+                    string collected, spilled;
+                    {
+                        buffered_writer out(&collected);
+                        eds::block_graph::output_gfa(h, msa.size(), c, segments, out);
+                    }
+                    vector<string> window_names;
+                    for (seg_index j = 0; j < window.rows(); j++)
+                        window_names.push_back(window.name(j));
+                    eds::block_graph::path_spill spill(tmp + ".paths", window_names, segments.size(), 2);
+                    auto [s, spilled_card, spilled_size] = segment_columns(window, segments, false, &spill);
+                    check(s.paths.empty(), "segment_columns with a spill collects no paths");
+                    {
+                        buffered_writer out(&spilled);
+                        eds::block_graph::output_gfa(s, msa.size(), c, segments, out, 0, &spill);
+                    }
+                    check(spill.good() and spilled == collected, "GFA with spilled paths equals the GFA with collected paths");
+                }
+                eds::column_store::row_classes whole, chunked;
+                std::unordered_multimap<uint64_t, uint32_t> table;
+                eds::column_store::segment_row_classes(rows, 1, c, whole, table);
+                eds::column_store::chunked_row_classes(window, 1, c, chunked, table);
+                check(chunked.class_of == whole.class_of and chunked.labels == whole.labels, "chunked_row_classes over all columns equals segment_row_classes");
+                if (block_width == 1 and c > 1) {
+                    // a column file truncated before or after it is opened is not read as zeros
+                    std::filesystem::copy_file(tmp + ".cols", tmp + ".cols.short", std::filesystem::copy_options::overwrite_existing);
+                    column_window shortened(tmp + ".cols.short");
+                    std::filesystem::resize_file(tmp + ".cols.short", std::filesystem::file_size(tmp + ".cols") - msa.size());
+                    check(!column_window(tmp + ".cols.short").good(), "column_window rejects a truncated file");
+                    shortened.require(1, c);
+                    check(!shortened.good(), "column_window reports a short read of a block");
+                    std::filesystem::remove(tmp + ".cols.short");
+                }
+            }
+
+            // size and weighted objectives against brute force, and against the built graph
+            for (objective obj : { objective{ 0, 1 }, objective{ 1, 1 }, objective{ 3, 2 } }) {
+                vector<bool> gap_columns;
+                if (allow_perfect_segments)
+                    compute_perfect_columns(msa, &gap_columns);
+                auto L_w = compute_meaningful_extensions(msa, 1, U, obj);
+                auto [weighted_cost, weighted_segments] = segment_with_rmq(L_w, c, perfect_columns, obj, gap_columns);
+                const string weights = to_string(obj.card_weight) + " * card + " + to_string(obj.size_weight) + " * size";
+                check(weighted_cost == brute_force_mincard(msa, U, perfect_columns, obj), "segment_with_rmq cost equals the brute-force DP for " + weights);
+                check(valid_segmentation(weighted_segments, c, U, perfect_columns), "segment_with_rmq returns a valid segmentation for " + weights);
+                auto [w, w_card, w_size] = segment_columns(rows, weighted_segments);
+                check(obj.cost(w_card, w_size) == weighted_cost, "block graph of the segmentation has the DP cost for " + weights);
+                check(obj.cost(w_card, w_size) <= obj.cost(card, size), "segmentation is not worse than the minimum cardinality one for " + weights);
+                column_window window(tmp + ".cols");
+                streaming_extensions<column_window> streamed(window, 1, U, obj);
+                check(segment_with_rmq(streamed, c, perfect_columns, obj, gap_columns) == make_pair(weighted_cost, weighted_segments), "streamed DP equals the in-memory DP for " + weights);
+            }
+
+            check_query_engine(g, rng);
+            check_region_merge(msa, U, allow_perfect_segments, tmp, rng);
+
+            // incremental update from the first rows against the DP on all rows
+            if (msa.size() > 1) {
+                const seg_index old_rows = 1 + rng() % (msa.size() - 1);
+                vector<string> first_rows(msa.begin(), msa.begin() + old_rows);
+                eds::incremental::state st;
+                st.U = U;
+                st.rows = old_rows;
+                st.columns = c;
+                st.L_y = compute_meaningful_extensions(first_rows, 1, U);
+                st.S = segment_with_rmq(st.L_y, c, perfect_columns).second;
+                st.classes = eds::incremental::compute_classes(in_memory_msa(first_rows), st.S);
+                vector<string> edited = first_rows;
+                edited.back()[rng() % c] ^= 1;
+                check(eds::incremental::hash_rows(edited) != eds::incremental::hash_rows(first_rows), "hash_rows detects an edited row of the saved MSA");
+                eds::incremental::add_rows(st, msa);
+                check(st.L_y == L_y, "add_rows extensions equal compute_meaningful_extensions on all rows");
+
+                eds::incremental::extend_classes(st, msa, old_rows);
+                vector<string> names;
+                for (size_t i = 0; i < msa.size(); ++i) names.push_back("seq" + to_string(i + 1));
+                eds::block_graph::class_graph_builder builder(names, st.S.size(), true);
+                for (const auto& classes : st.classes) builder.add_block(classes);
+                auto [patched, patched_card, patched_size] = builder.finish();
+                auto [reference, reference_card, reference_size] = segment_msa(tmp, c, st.S, true);
+                check(patched_card == reference_card and patched_size == reference_size, "extend_classes cardinality and size equal segment_msa");
+                check(canonical_eds(patched) == canonical_eds(reference) and canonical_edges(patched) == canonical_edges(reference) and path_labels(patched) == path_labels(reference), "extend_classes graph equals segment_msa");
+            }
+        }
+    }
+    std::filesystem::remove(tmp);
+    std::filesystem::remove(tmp + ".cols");
+}
+
+// batch mode on a manifest of random MSAs, some of them wrapped, against segmenting each one alone:
+// the archive holds every output at its indexed offset, with the results in manifest order
+void check_batch(std::mt19937& rng) {
+    const string dir = (std::filesystem::temp_directory_path() / ("eds-difftest-batch-" + to_string(getpid()))).string();
+    std::filesystem::create_directories(dir);
+    vector<string> inputs;
+    vector<vector<string>> msas;
+    for (int k = 0; k < 12; ++k) {
+        msas.push_back(random_msa(rng));
+        inputs.push_back(dir + "/msa" + to_string(k) + ".fasta");
+        write_fasta(inputs.back(), msas.back(), rng() % 4);
+    }
+    inputs.push_back(dir + "/ragged.fasta");
+    write_fasta(inputs.back(), { "ACGT", "ACG" });
+    inputs.push_back(dir + "/missing.fasta");
+    eds::batch::options opt;
+    opt.U = 1 + rng() % 5;
+    opt.gfa_output = true;
+    context = "batch of " + to_string(msas.size()) + " random MSAs, U = " + to_string(opt.U) + "\n";
+
+    // a manifest lists the MSAs relative to its directory
+    {
+        std::ofstream manifest(dir + "/manifest.txt");
+        manifest << "# MSAs\n";
+        for (auto& input : inputs)
+            manifest << std::filesystem::path(input).filename().string() << "\n";
+    }
+    string error;
+    check(eds::batch::list_inputs(dir + "/manifest.txt", error) == inputs, "list_inputs resolves manifest paths against its directory");
+    check(!eds::batch::archive(dir + "/missing/archive.gfa").good(), "an archive that cannot be opened fails before the batch runs");
+
+    eds::batch::archive combined(dir + "/archive.gfa");
+    auto results = eds::batch::run(inputs, opt, 3, &combined);
+    unordered_map<string, pair<size_t, size_t>> members;
+    ifstream idx(dir + "/archive.gfa.idx");
+    string path;
+    size_t offset, length;
+    while (idx >> path >> offset >> length)
+        members[path] = { offset, length };
+    ifstream data(dir + "/archive.gfa", std::ios::binary);
+    string archive((std::istreambuf_iterator<char>(data)), std::istreambuf_iterator<char>());
+
+    check(results.size() == inputs.size() and !results.back().error.empty() and members.count(inputs.back()) == 0, "batch reports the missing MSA and leaves it out of the archive");
+    check(results.size() == inputs.size() and results[msas.size()].error == "rows differ in length" and members.count(inputs[msas.size()]) == 0, "batch rejects an MSA with rows of different lengths");
+    vector<string> rows, names;
+    for (size_t k = 0; k < msas.size() and k < results.size(); ++k) {
+        eds::mincard::read_fasta_into(inputs[k], rows, &names);
+        check(rows == msas[k] and names.size() == rows.size() and names[0] == "seq1", "read_fasta_into reads the rows and names, reusing buffers");
+
+        auto L_y = compute_meaningful_extensions(msas[k], opt.L, opt.U);
+        auto [cost, segments] = segment_with_rmq(L_y, msas[k][0].size());
+        in_memory_msa alone(msas[k], &names);
+        auto [g, card, size] = segment_columns(alone, segments, true);
+        string expected;
+        {
+            buffered_writer out(&expected);
+            eds::block_graph::output_gfa(g, msas[k].size(), msas[k][0].size(), segments, out);
+        }
+        check(results[k].path == inputs[k] and results[k].error.empty() and results[k].card == cost and results[k].size == size, "batch result equals segmenting " + inputs[k] + " alone");
+        auto it = members.find(inputs[k]);
+        check(it != members.end() and archive.compare(it->second.first, it->second.second, expected) == 0, "archive member of " + inputs[k] + " equals its GFA");
+    }
+    std::filesystem::remove_all(dir);
+}
+
+// failed opens and writes are reported by buffered_writer instead of leaving a truncated output
+void check_writer_failures() {
+    context = "buffered_writer on unwritable files\n";
+    {
+        buffered_writer out("/nonexistent-eds-difftest/out.gfa");
+        check(!out.good() and !out.close(), "buffered_writer reports a file it cannot open");
+    }
+    if (std::filesystem::exists("/dev/full")) {
+        buffered_writer out("/dev/full", 16);
+        out << "S\t0\tACGT\n" << string(64, 'A');
+        check(!out.close() and !out.good(), "buffered_writer reports writes to a full device");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 1000;
+    unsigned seed = 1;
+    vector<string> files;
+    if (argc > 1)
+        iterations = atoll(argv[1]);
+    if (argc > 2)
+        seed = atoi(argv[2]);
+    for (int i = 3; i < argc; ++i)
+        files.push_back(argv[i]);
+
+    cout << "eds-difftest version " << VERSION << endl;
+    cout << "Syntax: " << string(argv[0]) << " iterations (default 1000) seed (default 1) [msa.fasta ...]" << endl;
+
+    std::mt19937 rng(seed);
+    for (const auto& file : files) {
+        auto msa = read_fasta(file);
+        if (msa.empty()) {
+            cerr << "MSA file " << file << " is empty or not found.\n";
+            return 1;
+        }
+        test_msa(msa, "MSA " + file, rng);
+    }
+    check_writer_failures();
+    check_batch(rng);
+    for (size_t it = 0; it < iterations and failures == 0; ++it) {
+        auto msa = random_msa(rng);
+        test_msa(msa, "random MSA " + to_string(it) + " (seed " + to_string(seed) + ")", rng);
+    }
+
+    cout << checks << " checks, " << failures << " failures" << endl;
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "region_merge.hpp"
+
+using namespace std;
+using eds::io::buffered_writer;
+using eds::region_merge::merge_gfa, eds::region_merge::merge_eds;
+
+// Concatenates the outputs of msa2eds-mincard --region a-b on consecutive regions of an MSA
+int main(int argc, char* argv[]) {
+    // the merged output goes to stdout, so the log goes to stderr
+    if (argc > 1 and string(argv[1]) == "-")
+      cout.rdbuf(cerr.rdbuf());
+
+    cout << "eds-merge version " << VERSION << endl;
+    if (argc < 3) {
+      cout << "Syntax: " << string(argv[0]) << " out.(gfa|eds) region1.(gfa|eds) region2.(gfa|eds) ..." << endl;
+      cout << "Regions are given in column order; regions must continue each other, which EDS regions show by their .a-b.eds names from --region. Output - for stdout." << endl;
+      return 0;
+    }
+
+    const string out_filename = argv[1];
+    vector<string> inputs(argv + 2, argv + argc);
+    ifstream first(inputs[0]);
+    const int format = first.peek();
+    if (!first or format == EOF) {
+      cerr << "Region file " << inputs[0] << " is empty or not found.\n";
+      return 1;
+    }
+    first.close();
+
+    buffered_writer out(out_filename);
+    if (!out.good()) {
+      cerr << "Cannot open " << out_filename << " for writing.\n";
+      return 1;
+    }
+    string error;
+    const bool ok = (format == '{') ? merge_eds(inputs, out, error) : merge_gfa(inputs, out, error);
+    if (!ok) {
+      cerr << "Cannot merge: " << error << ".\n";
+      return 1;
+    }
+    if (!out.close()) {
+      cerr << "Cannot write " << out_filename << ".\n";
+      return 1;
+    }
+    return 0;
+}
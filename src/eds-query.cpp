@@ -0,0 +1,186 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <thread>
+
+#include "block_graph.hpp"
+#include "mincard.hpp"
+#include "eds_query.hpp"
+
+using namespace std::chrono;
+using namespace std;
+using eds::block_graph::segment_columns;
+using eds::column_store::in_memory_msa;
+using eds::mincard::read_fasta, eds::mincard::rows_aligned, eds::mincard::compute_meaningful_extensions, eds::mincard::compute_perfect_columns, eds::mincard::segment_with_rmq, eds::mincard::segment_greedy;
+using eds::query::compact, eds::query::match_all, eds::query::MAX_PATTERN_LENGTH;
+
+typedef eds::block_graph::seg_index seg_index;
+
+// Reads one pattern per line, skipping empty lines and FASTA headers
+vector<string> read_patterns(const string& filename) {
+    ifstream in(filename);
+    vector<string> patterns;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() or line[0] == '>') continue;
+        patterns.push_back(line);
+    }
+    return patterns;
+}
+
+// Samples patterns of the given length from the gap-free input sequences
+vector<string> sample_patterns(const vector<string>& msa, size_t count, size_t length, unsigned seed) {
+    std::mt19937 rng(seed);
+    vector<string> sequences;
+    for (const auto& row : msa) {
+        string s = row;
+        s.erase(remove(s.begin(), s.end(), '-'), s.end());
+        if (s.size() >= length)
+            sequences.push_back(std::move(s));
+    }
+    vector<string> patterns;
+    if (sequences.empty())
+        return patterns;
+    patterns.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const string& s = sequences[rng() % sequences.size()];
+        patterns.push_back(s.substr(rng() % (s.size() - length + 1), length));
+    }
+    return patterns;
+}
+
+int main(int argc, char* argv[]) {
+    seg_index U = 10;
+    bool allow_perfect_segments = false;
+    bool trivial_segmentation = false;
+    bool greedy_segmentation = false;
+    bool report = false;
+    unsigned threads = 1;
+    size_t random_count = 0, random_length = 0;
+    unsigned random_seed = 0;
+    string trace_filename = "";
+
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+      const string arg = argv[i];
+      if (arg == "--greedy")
+        greedy_segmentation = true;
+      else if (arg == "--trivial")
+        trivial_segmentation = true;
+      else if (arg == "--report")
+        report = true;
+      else if (arg == "--trace" and i + 1 < argc)
+        trace_filename = argv[++i];
+      else if (arg == "--random" and i + 3 < argc) {
+        random_count = atoll(argv[++i]);
+        random_length = atoll(argv[++i]);
+        random_seed = atoi(argv[++i]);
+      } else if (arg.rfind("--", 0) == 0) {
+        cerr << "Unknown option " << arg << endl;
+        return 1;
+      } else
+        args.push_back(arg);
+    }
+
+    cout << "eds-query version " << VERSION << endl;
+    if (args.empty() or (args.size() < 2 and random_count == 0)) {
+      cout << "Syntax: " << string(argv[0]) << " msa.fasta patterns.txt segment-length-upper-bound (default " << U << ") allow-perfect-segments (default 0) threads (default 1)" << endl;
+      cout << "Options:" << endl;
+      cout << "  --random N M SEED   query N patterns of length M sampled from the MSA instead of patterns.txt" << endl;
+      cout << "  --greedy            greedy instead of minimum cardinality segmentation" << endl;
+      cout << "  --trivial           one segment per column" << endl;
+      cout << "  --report            print the number of occurrences and the blocks where they end for every pattern" << endl;
+      cout << "  --trace PATH        write a Chrome/Perfetto trace of the run to PATH (builds with make TRACE=1)" << endl;
+      return 0;
+    }
+
+    const string filename = args[0];
+    size_t next = 1; // with --random the patterns file is omitted
+    const string patterns_filename = (random_count == 0) ? args[next++] : "";
+    if (args.size() > next)
+      U = atoi(args[next].c_str());
+    if (args.size() > next + 1)
+      allow_perfect_segments = atoi(args[next + 1].c_str()) > 0;
+    if (args.size() > next + 2)
+      threads = max(1, atoi(args[next + 2].c_str()));
+    cout << "Input file: " << filename << ", upper bound: " << U << ", allow-perfect-segments: " << ((allow_perfect_segments) ? "true" : "false") << ", segmentation: " << ((trivial_segmentation) ? "trivial" : (greedy_segmentation) ? "greedy" : "mincard") << ", threads: " << threads << endl;
+
+    if (!trace_filename.empty() and !eds::trace::enabled) {
+      cerr << "--trace requires a build with tracing, make clean and make TRACE=1.\n";
+      return 1;
+    }
+    eds::trace::output_on_exit trace_output(trace_filename);
+
+    auto msa = read_fasta(filename);
+    if (msa.empty()) {
+      cerr << "MSA file is empty or not found.\n";
+      return 1;
+    }
+    if (!rows_aligned(msa)) {
+      cerr << "MSA rows differ in length.\n";
+      return 1;
+    }
+
+    vector<string> patterns = (random_count > 0) ? sample_patterns(msa, random_count, random_length, random_seed) : read_patterns(patterns_filename);
+    if (patterns.empty()) {
+      if (random_count > 0)
+        cerr << "No sequence of the MSA has " << random_length << " characters to sample patterns from.\n";
+      else
+        cerr << "Patterns file is empty or not found.\n";
+      return 1;
+    }
+    for (const auto& p : patterns) {
+      if (p.empty() or p.size() > MAX_PATTERN_LENGTH) {
+        cerr << "Pattern lengths must be between 1 and " << MAX_PATTERN_LENGTH << ".\n";
+        return 1;
+      }
+    }
+
+    auto start_build = high_resolution_clock::now();
+    const seg_index c = msa[0].size();
+    vector<pair<seg_index, seg_index>> segments;
+    vector<bool> perfect_columns = {};
+    if (allow_perfect_segments)
+      perfect_columns = compute_perfect_columns(msa).second;
+    if (trivial_segmentation) {
+      for (seg_index i = 1; i <= c; ++i)
+        segments.push_back({ i, i });
+    } else if (greedy_segmentation) {
+      segments = segment_greedy(msa, U, perfect_columns).second;
+    } else {
+      auto L_y = compute_meaningful_extensions(msa, 1, U);
+      segments = segment_with_rmq(L_y, c, perfect_columns).second;
+    }
+    in_memory_msa rows(msa);
+    auto [graph, card, size] = segment_columns(rows, segments);
+    auto eds = compact(graph);
+    auto stop_build = high_resolution_clock::now();
+    cout << "Building the EDS took " << duration_cast<milliseconds>(stop_build-start_build).count() << " milliseconds" << endl;
+    cout << "EDS blocks: " << segments.size() << ", cardinality: " << card << ", gap-aware size: " << size << endl;
+
+    auto start_query = high_resolution_clock::now();
+    auto results = match_all(eds, patterns, threads);
+    auto stop_query = high_resolution_clock::now();
+    const double seconds = duration_cast<microseconds>(stop_query-start_query).count() / 1e6;
+
+    size_t matching = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+      matching += (results[i].occurrences > 0);
+      if (report) {
+        cout << patterns[i] << "\t" << results[i].occurrences << "\t";
+        for (size_t j = 0; j < results[i].blocks.size(); ++j)
+          cout << ((j == 0) ? "" : ",") << results[i].blocks[j];
+        cout << "\n";
+      }
+    }
+    cout << "Queried " << patterns.size() << " patterns (" << matching << " occur) in " << seconds * 1000 << " milliseconds" << endl;
+    if (seconds > 0)
+      cout << "Throughput: " << patterns.size() / seconds << " patterns/s, " << (double)patterns.size() * eds.text.size() / seconds / 1e6 << " MB/s of EDS text" << endl;
+    else
+      cout << "Throughput: not measurable, the queries took less than a microsecond" << endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+#ifndef EDS_QUERY_HPP
+#define EDS_QUERY_HPP
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "block_graph.hpp"
+#include "trace.hpp"
+
+/* exact pattern matching over the EDS spelled by a block graph, i.e. over any choice of
+ * one label per block, with bit-parallel Shift-And carried across block boundaries */
+namespace eds::query {
+    using eds::block_graph::block_graph;
+    const std::size_t MAX_PATTERN_LENGTH = 64; // one machine word of Shift-And state
+
+    /* all labels in one character array: labels of block i are label_start[block_start[i]..block_start[i+1]) */
+    struct compact_eds {
+        std::string text;
+        std::vector<std::size_t> label_start; // one past the last label holds text.size()
+        std::vector<std::size_t> block_start; // one past the last block holds the number of labels
+    };
+
+    /* labels within a block are ordered by node id, so the layout does not depend on hashing */
+    compact_eds compact(const block_graph &g) {
+        EDS_TRACE_SPAN("compact");
+        compact_eds eds;
+        std::size_t labels = 0, chars = 0;
+        for (auto &b : g.blocks) {
+            labels += b.size();
+            for (auto &[label, _] : b)
+                chars += label.size();
+        }
+        eds.text.reserve(chars);
+        eds.label_start.reserve(labels + 1);
+        eds.block_start.reserve(g.blocks.size() + 1);
+
+        vector<pair<unsigned long, const string *>> block;
+        for (auto &b : g.blocks) {
+            block.clear();
+            for (auto &[label, node] : b)
+                block.emplace_back(node, &label);
+            std::sort(block.begin(), block.end());
+            eds.block_start.push_back(eds.label_start.size());
+            for (auto &[_, label] : block) {
+                eds.label_start.push_back(eds.text.size());
+                eds.text += *label;
+            }
+        }
+        eds.label_start.push_back(eds.text.size());
+        eds.block_start.push_back(eds.label_start.size() - 1);
+        return eds;
+    }
+
+    struct match_result {
+        std::size_t occurrences = 0; // (block, label, offset) positions where an occurrence ends
+        vector<std::size_t> blocks; // blocks in which an occurrence ends, increasing
+    };
+
+    /* requires: 0 < |pattern| <= MAX_PATTERN_LENGTH */
+    match_result shift_and(const compact_eds &eds, const string &pattern) {
+        uint64_t masks[256] = { 0 };
+        for (std::size_t j = 0; j < pattern.size(); j++)
+            masks[(unsigned char)pattern[j]] |= (uint64_t)1 << j;
+        const uint64_t accept = (uint64_t)1 << (pattern.size() - 1);
+
+        match_result result;
+        uint64_t state = 0; // prefixes of the pattern ending at the end of the previous block
+        const std::size_t blocks = eds.block_start.size() - 1;
+        for (std::size_t b = 0; b < blocks; b++) {
+            uint64_t next_state = 0;
+            std::size_t hits = 0;
+            for (std::size_t l = eds.block_start[b]; l < eds.block_start[b + 1]; l++) {
+                uint64_t d = state;
+                const char *p = eds.text.data() + eds.label_start[l];
+                const char *end = eds.text.data() + eds.label_start[l + 1];
+                for (; p != end; ++p) {
+                    d = ((d << 1) | 1) & masks[(unsigned char)*p];
+                    hits += (d & accept) != 0;
+                }
+                next_state |= d; // the empty label carries state over unchanged
+            }
+            if (hits > 0) {
+                result.occurrences += hits;
+                result.blocks.push_back(b);
+            }
+            state = next_state;
+        }
+        return result;
+    }
+
+    /* runs the patterns on the given number of threads, patterns are handed out one at a time */
+    vector<match_result> match_all(const compact_eds &eds, const vector<string> &patterns, unsigned threads) {
+        vector<match_result> results(patterns.size());
+        std::atomic<std::size_t> next(0);
+        auto worker = [&]() {
+            EDS_TRACE_SPAN("match_all worker");
+            for (std::size_t i = next++; i < patterns.size(); i = next++)
+                results[i] = shift_and(eds, patterns[i]);
+        };
+        vector<std::thread> pool;
+        for (unsigned t = 1; t < threads; t++)
+            pool.emplace_back(worker);
+        worker();
+        for (auto &t : pool)
+            t.join();
+        return results;
+    }
+} // namespace eds::query
+#endif // EDS_QUERY_HPP
@@ -0,0 +1,116 @@
+#ifndef FASTA_INDEX_HPP
+#define FASTA_INDEX_HPP
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* samtools-compatible FASTA index (.fai) for random access to column ranges of every row */
+namespace eds::fasta_index {
+    struct fai_record {
+        std::string name;
+        uint64_t length = 0; // bases
+        uint64_t offset = 0; // of the first base
+        uint64_t line_bases = 0, line_width = 0; // bases per line, and bytes including the newline
+    };
+
+    /* returns: false if a record has lines of varying length other than its last line, or
+     * sequence lines after an empty line */
+    bool build_index(const std::string &fasta_path, std::vector<fai_record> &records) {
+        std::ifstream in(fasta_path, std::ios::binary);
+        records.clear();
+        std::string line;
+        uint64_t position = 0;
+        bool last_line_seen = false; // a shorter line ends the record
+        while (std::getline(in, line)) {
+            const uint64_t width = line.size() + 1;
+            if (!line.empty() and line.back() == '\r')
+                line.pop_back();
+            if (!line.empty() and line[0] == '>') {
+                records.emplace_back();
+                records.back().name = line.substr(1, line.find_first_of(" \t") - 1);
+                records.back().offset = position + width;
+                last_line_seen = false;
+            } else if (!line.empty() and !records.empty()) {
+                fai_record &r = records.back();
+                if (last_line_seen)
+                    return false;
+                if (r.line_bases == 0) {
+                    r.line_bases = line.size();
+                    r.line_width = width;
+                } else if (line.size() > r.line_bases) {
+                    return false;
+                }
+                last_line_seen = (line.size() < r.line_bases);
+                r.length += line.size();
+            } else if (line.empty()) {
+                last_line_seen = true; // so does an empty line, as samtools faidx requires
+            }
+            position += width;
+        }
+        return !records.empty();
+    }
+
+    void write_index(const std::string &fai_path, const std::vector<fai_record> &records) {
+        std::ofstream out(fai_path);
+        for (auto &r : records)
+            out << r.name << "\t" << r.length << "\t" << r.offset << "\t" << r.line_bases << "\t" << r.line_width << "\n";
+    }
+
+    bool read_index(const std::string &fai_path, std::vector<fai_record> &records) {
+        std::ifstream in(fai_path);
+        records.clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            fai_record r;
+            if (!(fields >> r.name >> r.length >> r.offset >> r.line_bases >> r.line_width))
+                return false;
+            records.push_back(r);
+        }
+        return !records.empty();
+    }
+
+    /* reads fasta_path.fai, (re)building it if it is missing or older than the FASTA */
+    bool load_index(const std::string &fasta_path, std::vector<fai_record> &records) {
+        const std::string fai_path = fasta_path + ".fai";
+        std::error_code ec;
+        if (std::filesystem::exists(fai_path) and std::filesystem::last_write_time(fai_path, ec) >= std::filesystem::last_write_time(fasta_path, ec)
+            and read_index(fai_path, records))
+            return true;
+        if (!build_index(fasta_path, records))
+            return false;
+        write_index(fai_path, records);
+        return true;
+    }
+
+    /* requires: 1 <= a <= b <= length of every record
+     * returns: columns a..b of every record, seeking directly to them, or no rows if the
+     * FASTA is shorter than its index says */
+    std::vector<std::string> read_region(const std::string &fasta_path, const std::vector<fai_record> &records, uint64_t a, uint64_t b) {
+        std::ifstream in(fasta_path, std::ios::binary);
+        std::vector<std::string> rows;
+        rows.reserve(records.size());
+        std::string bytes;
+        for (auto &r : records) {
+            auto byte_of = [&](uint64_t column) { // 1-indexed
+                return r.offset + (column - 1) / r.line_bases * r.line_width + (column - 1) % r.line_bases;
+            };
+            const uint64_t first = byte_of(a), last = byte_of(b);
+            bytes.resize(last - first + 1);
+            in.seekg(first);
+            in.read(bytes.data(), bytes.size());
+            if (!in)
+                return {};
+            rows.emplace_back();
+            rows.back().reserve(b - a + 1);
+            for (const char ch : bytes)
+                if (ch != '\n' and ch != '\r')
+                    rows.back().push_back(ch);
+        }
+        return rows;
+    }
+} // namespace eds::fasta_index
+#endif // FASTA_INDEX_HPP
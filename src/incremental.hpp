@@ -0,0 +1,236 @@
+#ifndef INCREMENTAL_HPP
+#define INCREMENTAL_HPP
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "block_graph.hpp"
+#include "column_store.hpp"
+
+/* incremental update of a minimum cardinality segmentation when rows are added to the MSA:
+ * the state of a run (L_y, segmentation, row classes of every segment) is saved next to the
+ * MSA, and add_rows updates the heights of L_y only where the new rows bring new labels */
+namespace eds::incremental {
+    typedef eds::block_graph::seg_index seg_index;
+    using eds::block_graph::segmentation;
+    using eds::column_store::row_classes, eds::column_store::hash_mul, eds::column_store::hash_push, eds::column_store::HASH_MOD, eds::column_store::HASH_BASE;
+    namespace detail = eds::column_store::detail;
+    const char STATE_MAGIC[8] = { 'E', 'D', 'S', 'S', 'T', 'A', 'T', '2' };
+
+    struct state {
+        seg_index L = 1, U = 0;
+        bool allow_perfect_segments = false;
+        vector<string> sources; // FASTA files whose rows, in order, form the MSA
+        seg_index rows = 0, columns = 0;
+        uint64_t rows_hash = 0; // hash_rows of the MSA, to detect changed sources
+        vector<vector<pair<seg_index, seg_index>>> L_y; // as compute_meaningful_extensions
+        segmentation S;
+        vector<row_classes> classes; // per segment of S
+    };
+
+    /* polynomial hash of the rows in order, each ended by a newline */
+    uint64_t hash_rows(const vector<string> &msa) {
+        uint64_t h = 0;
+        for (auto &row : msa) {
+            for (const char ch : row)
+                h = hash_push(h, ch);
+            h = hash_push(h, '\n');
+        }
+        return h;
+    }
+
+    /* row classes of every segment of S, as used by class_graph_builder */
+    template <class MSA>
+    vector<row_classes> compute_classes(const MSA &msa, const segmentation &S) {
+        vector<row_classes> classes(S.size());
+        std::unordered_multimap<uint64_t, uint32_t> table;
+        for (std::size_t i = 0; i < S.size(); i++)
+            eds::column_store::segment_row_classes(msa, S[i].first, S[i].second, classes[i], table);
+        return classes;
+    }
+
+    bool save_state(const string &path, const state &st) {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(STATE_MAGIC, sizeof(STATE_MAGIC));
+        auto write_string = [&](const string &s) {
+            detail::write_u64(out, s.size());
+            out.write(s.data(), s.size());
+        };
+        detail::write_u64(out, st.L);
+        detail::write_u64(out, st.U);
+        detail::write_u64(out, st.allow_perfect_segments);
+        detail::write_u64(out, st.sources.size());
+        for (auto &source : st.sources)
+            write_string(source);
+        detail::write_u64(out, st.rows);
+        detail::write_u64(out, st.columns);
+        detail::write_u64(out, st.rows_hash);
+        for (seg_index y = 1; y <= st.columns; y++) {
+            detail::write_u64(out, st.L_y[y].size());
+            for (auto [start, height] : st.L_y[y]) {
+                detail::write_u64(out, start);
+                detail::write_u64(out, height);
+            }
+        }
+        detail::write_u64(out, st.S.size());
+        for (std::size_t i = 0; i < st.S.size(); i++) {
+            detail::write_u64(out, st.S[i].first);
+            detail::write_u64(out, st.S[i].second);
+            detail::write_u64(out, st.classes[i].labels.size());
+            for (auto &label : st.classes[i].labels)
+                write_string(label);
+            out.write(reinterpret_cast<const char *>(st.classes[i].class_of.data()), st.rows * sizeof(uint32_t));
+        }
+        return out.good();
+    }
+
+    bool load_state(const string &path, state &st) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(STATE_MAGIC)] = { 0 };
+        in.read(magic, sizeof(magic));
+        if (!in or !std::equal(magic, magic + sizeof(STATE_MAGIC), STATE_MAGIC))
+            return false;
+        auto read_string = [&]() {
+            string s(detail::read_u64(in), '\0');
+            in.read(s.data(), s.size());
+            return s;
+        };
+        st.L = detail::read_u64(in);
+        st.U = detail::read_u64(in);
+        st.allow_perfect_segments = detail::read_u64(in);
+        st.sources.resize(detail::read_u64(in));
+        for (auto &source : st.sources)
+            source = read_string();
+        st.rows = detail::read_u64(in);
+        st.columns = detail::read_u64(in);
+        st.rows_hash = detail::read_u64(in);
+        st.L_y.assign(st.columns + 1, {});
+        for (seg_index y = 1; y <= st.columns and in; y++) {
+            st.L_y[y].resize(detail::read_u64(in));
+            for (auto &[start, height] : st.L_y[y]) {
+                start = detail::read_u64(in);
+                height = detail::read_u64(in);
+            }
+        }
+        st.S.resize(detail::read_u64(in));
+        st.classes.resize(st.S.size());
+        for (std::size_t i = 0; i < st.S.size() and in; i++) {
+            st.S[i].first = detail::read_u64(in);
+            st.S[i].second = detail::read_u64(in);
+            st.classes[i].labels.resize(detail::read_u64(in));
+            for (auto &label : st.classes[i].labels)
+                label = read_string();
+            st.classes[i].class_of.resize(st.rows);
+            in.read(reinterpret_cast<char *>(st.classes[i].class_of.data()), st.rows * sizeof(uint32_t));
+        }
+        return bool(in);
+    }
+
+    /* requires: msa holds the st.rows rows of the state followed by the new rows
+     * updates st.L_y to the heights of the whole msa and returns the number of columns whose
+     * extensions changed; a new row raises the height of a window only if its gap-free label
+     * differs from the labels of all earlier rows, which is tested on prefix hashes of the
+     * rows kept for the last U + 1 columns, trying first the row that matched the previous
+     * window, so that rows close to an existing one cost O(U) per column */
+    seg_index add_rows(state &st, const vector<string> &msa) {
+        EDS_TRACE_SPAN("add_rows");
+        const seg_index old_rows = st.rows, R = msa.size(), U = st.U, L = st.L;
+        const seg_index width = U + 1;
+        vector<uint64_t> powers(U + 1, 1);
+        for (seg_index g = 1; g <= U; g++)
+            powers[g] = hash_mul(powers[g - 1], HASH_BASE);
+
+        // prefix hash and gap-free length of every row through column y, for the last U + 1 columns
+        vector<uint64_t> prefix(width * R, 0);
+        vector<seg_index> length(width * R, 0);
+        auto slot = [&](seg_index y) { return (y % width) * R; };
+        auto window = [&](seg_index i, seg_index x, seg_index y) {
+            const seg_index g = length[slot(y) + i] - length[slot(x - 1) + i];
+            const uint64_t h = (prefix[slot(y) + i] + HASH_MOD - hash_mul(prefix[slot(x - 1) + i], powers[g])) % HASH_MOD;
+            return pair<uint64_t, seg_index>(h, g);
+        };
+
+        vector<seg_index> candidate(R, -1), increase, heights;
+        seg_index changed = 0;
+        for (seg_index y = 1; y <= st.columns; y++) {
+            for (seg_index i = 0; i < R; i++) {
+                const char ch = msa[i][y - 1];
+                const bool base = (ch != eds::column_store::GAP_CHARACTER);
+                prefix[slot(y) + i] = (base) ? hash_push(prefix[slot(y - 1) + i], ch) : prefix[slot(y - 1) + i];
+                length[slot(y) + i] = length[slot(y - 1) + i] + base;
+            }
+            EDS_TRACE_COUNT(COLUMNS, 1);
+            if (y < L)
+                continue;
+
+            const seg_index lens = std::min(U, y) - L + 1;
+            increase.assign(lens, 0);
+            for (seg_index n = old_rows; n < R; n++) {
+                for (seg_index len = L; len <= std::min(U, y); len++) {
+                    const seg_index x = y - len + 1;
+                    const auto key = window(n, x, y);
+                    if (candidate[n] >= 0 and window(candidate[n], x, y) == key)
+                        continue;
+                    bool found = false;
+                    for (seg_index i = 0; i < n and !found; i++) {
+                        if (window(i, x, y) == key) {
+                            candidate[n] = i;
+                            found = true;
+                        }
+                    }
+                    if (!found)
+                        increase[len - L] += 1;
+                }
+            }
+            if (std::all_of(increase.begin(), increase.end(), [](seg_index v) { return v == 0; }))
+                continue;
+
+            // heights of the old extensions by length, plus the increase, compressed again
+            auto &current = st.L_y[y];
+            heights.assign(lens, 0);
+            for (std::size_t len = L, j = 0; len <= (std::size_t)std::min(U, y); len++) {
+                const seg_index start = y - len + 1;
+                while (j + 2 < current.size() and current[j + 1].first >= start)
+                    j++;
+                heights[len - L] = current[j].second + increase[len - L];
+            }
+            vector<pair<seg_index, seg_index>> updated;
+            for (seg_index len = L; len <= std::min(U, y); len++)
+                if (updated.empty() or updated.back().second != heights[len - L])
+                    updated.emplace_back(y - len + 1, heights[len - L]);
+            updated.emplace_back(std::max((seg_index)0, y - U), -1);
+            current = std::move(updated);
+            changed += 1;
+        }
+        st.rows = R;
+        return changed;
+    }
+
+    /* requires: st.S unchanged since the classes were computed for the first rows of msa
+     * adds the new rows to the classes, creating classes only for labels not seen before */
+    void extend_classes(state &st, const vector<string> &msa, seg_index old_rows) {
+        string label;
+        std::unordered_map<string, uint32_t> class_of_label;
+        for (std::size_t i = 0; i < st.S.size(); i++) {
+            auto &classes = st.classes[i];
+            class_of_label.clear();
+            for (uint32_t k = 0; k < classes.labels.size(); k++)
+                class_of_label.insert({ classes.labels[k], k });
+            classes.class_of.resize(msa.size());
+            for (seg_index n = old_rows; n < (seg_index)msa.size(); n++) {
+                label.clear();
+                for (seg_index y = st.S[i].first; y <= st.S[i].second; y++)
+                    if (msa[n][y - 1] != eds::column_store::GAP_CHARACTER)
+                        label.push_back(msa[n][y - 1]);
+                auto [it, inserted] = class_of_label.insert({ label, classes.labels.size() });
+                if (inserted)
+                    classes.labels.push_back(label);
+                classes.class_of[n] = it->second;
+            }
+        }
+    }
+} // namespace eds::incremental
+#endif // INCREMENTAL_HPP
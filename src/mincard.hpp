@@ -0,0 +1,418 @@
+#ifndef MINCARD_HPP
+#define MINCARD_HPP
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "RMaxQTree.h"
+#include "block_graph.hpp"
+#include "column_store.hpp"
+#include "trace.hpp"
+
+using std::vector;
+using std::string;
+using std::ifstream;
+using std::pair;
+using std::set, std::unordered_set;
+using std::max, std::remove, std::reverse;
+using std::numeric_limits;
+
+/* minimum cardinality segmentation of an MSA: preprocessing of meaningful extensions,
+ * the RMQ-driven DP, and the greedy heuristic; shared by the command line tools */
+namespace eds::mincard {
+    typedef eds::block_graph::seg_index seg_index;
+    typedef long long int key_type;
+    using eds::column_store::in_memory_msa, eds::column_store::requires_column_access, eds::column_store::hash_push;
+
+    /* cost of a segment: card_weight * height + size_weight * size, where size is the
+     * gap-aware size of its labels (sum of max(|label|, 1), as reported by segment_msa);
+     * the default is the cardinality */
+    struct objective {
+        seg_index card_weight = 1, size_weight = 0;
+        seg_index cost(seg_index height, seg_index size) const { return card_weight * height + size_weight * size; }
+    };
+
+    // Reads sequences from a FASTA file, and their names (header up to the first whitespace) if asked
+    vector<string> read_fasta(const string& filename, vector<string>* names = nullptr) {
+        EDS_TRACE_SPAN("read_fasta");
+        ifstream in(filename);
+        vector<string> sequences;
+        string line, current, name;
+
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            if (line[0] == '>') {
+                if (!current.empty()) {
+                    sequences.push_back(current);
+                    current.clear();
+                    if (names != nullptr) names->push_back(name);
+                }
+                name = line.substr(1, line.find_first_of(" \t") - 1);
+            } else {
+                current += line;
+            }
+        }
+        if (!current.empty()) {
+            sequences.push_back(current);
+            if (names != nullptr) names->push_back(name);
+        }
+
+        return sequences;
+    }
+
+    // As read_fasta, into sequences and names, reusing the buffers of their strings from an earlier call
+    void read_fasta_into(const string& filename, vector<string>& sequences, vector<string>* names = nullptr) {
+        EDS_TRACE_SPAN("read_fasta");
+        ifstream in(filename);
+        string line;
+        size_t count = 0; // complete sequences
+        bool open = false;
+        auto slot = [&](vector<string>& v) -> string& {
+            if (v.size() <= count) v.emplace_back();
+            return v[count];
+        };
+
+        while (getline(in, line)) {
+            if (line.empty()) continue;
+            if (line[0] == '>' or !open) {
+                if (open and !sequences[count].empty())
+                    count += 1;
+                slot(sequences).clear();
+                if (names != nullptr)
+                    slot(*names) = (line[0] == '>') ? line.substr(1, line.find_first_of(" \t") - 1) : "";
+                open = true;
+            }
+            if (line[0] != '>')
+                sequences[count] += line;
+        }
+        if (open and !sequences[count].empty())
+            count += 1;
+        sequences.resize(count);
+        if (names != nullptr)
+            names->resize(count);
+    }
+
+    // True if all rows of the MSA have the same length, which the segmentations and block graphs require
+    bool rows_aligned(const vector<string>& msa) {
+        return std::all_of(msa.begin(), msa.end(), [&](const string& row) { return row.size() == msa[0].size(); });
+    }
+
+    /* meaningful left extensions of column y and their heights; MSA is a column accessor
+     * (see column_store.hpp) on which columns max(1, y - U + 1)..y are resident
+     * notes: the size of every window is summed alongside its height, and with an objective
+     * other than the cardinality the extensions are those where the cost changes, paired
+     * with the cost instead of the height */
+    template <class MSA>
+    vector<pair<seg_index, seg_index>> meaningful_extensions_at(
+        const MSA& msa, seg_index y, seg_index L, seg_index U, const objective& obj = objective())
+    {
+        seg_index r = msa.rows();
+        vector<pair<seg_index, seg_index>> current;
+        EDS_TRACE_COUNT(COLUMNS, 1);
+        if (y < L) {
+            return current;  // No extension possible
+        }
+
+        // Enforce ℓ_{y,1} = y - L + 1 down to ℓ_{y,d_y} > y - U
+        seg_index prev_cost = -1;
+        string s;
+        for (seg_index len = L; len <= U && y - len + 1 >= 1; ++len) {
+            seg_index start = y - len + 1;
+            unordered_set<string> unique_strings;
+
+            for (seg_index i = 0; i < r; ++i) {
+                msa.gapless(i, start, y, s);  // remove gaps
+                unique_strings.insert(s);
+            }
+            EDS_TRACE_COUNT(STRINGS_HASHED, r);
+
+            seg_index height = unique_strings.size(), size = 0;
+            if (obj.size_weight != 0)
+                for (const auto& label : unique_strings)
+                    size += max((seg_index)label.size(), (seg_index)1);
+            const seg_index cost = obj.cost(height, size);
+            if (cost != prev_cost) {
+                current.emplace_back(start, cost);
+                prev_cost = cost;
+            }
+        }
+
+        // Add dummy ℓ_{y,d_y+1} = max(0, y - U)
+        current.emplace_back(max((seg_index)0, y - U), -1);
+        return current;
+    }
+
+    vector<vector<pair<seg_index, seg_index>>> compute_meaningful_extensions(
+        const vector<string>& msa, seg_index L, seg_index U, const objective& obj = objective())
+    {
+        EDS_TRACE_SPAN("compute_meaningful_extensions");
+        seg_index c = msa[0].size();
+        in_memory_msa rows(msa);
+
+        vector<vector<pair<seg_index, seg_index>>> L_y(c + 1);  // 1-based indexing
+
+        for (seg_index y = 1; y <= c; ++y) {
+            L_y[y] = meaningful_extensions_at(rows, y, L, U, obj);
+        }
+
+        return L_y;
+    }
+
+    /* L_y computed on demand for increasing y over a streamed MSA, for segment_with_rmq;
+     * only the extensions of the last column asked for are kept */
+    template <class MSA>
+    class streaming_extensions {
+    private:
+        MSA &msa;
+        seg_index L, U, y = 0;
+        objective obj;
+        vector<pair<seg_index, seg_index>> current;
+
+    public:
+        streaming_extensions(MSA &msa, seg_index L, seg_index U, const objective& obj = objective()) : msa(msa), L(L), U(U), obj(obj) {}
+
+        const vector<pair<seg_index, seg_index>> &operator[](seg_index column) {
+            if (column != y) {
+                y = column;
+                msa.require(max((seg_index)1, y - U + 1), y);
+                current = meaningful_extensions_at(msa, y, L, U, obj);
+            }
+            return current;
+        }
+    };
+
+    /* gap_columns, if given, marks the perfect columns of gaps only (for a size objective) */
+    template <class MSA, typename = requires_column_access<MSA>>
+    pair<seg_index,vector<bool>> compute_perfect_columns(
+        MSA& msa, vector<bool>* gap_columns = nullptr) {
+        EDS_TRACE_SPAN("compute_perfect_columns");
+        seg_index r = msa.rows();
+        seg_index c = msa.columns();
+        seg_index np = 0;
+        assert(r > 0);
+
+        vector<bool> perfect_columns(c + 1, true); // 1-indexed
+        if (gap_columns != nullptr)
+            gap_columns->assign(c + 1, false);
+        for (seg_index y = 1; y <= c; ++y) {
+            msa.require(y, y);
+            const char consensus = msa.at(0, y);
+            for (seg_index i = 2; i <= r; ++i) {
+                if (msa.at(i-1, y) != consensus) {
+                    perfect_columns[y] = false;
+                    np += 1;
+                    break;
+                }
+            }
+            if (gap_columns != nullptr and perfect_columns[y] and consensus == eds::column_store::GAP_CHARACTER)
+                (*gap_columns)[y] = true;
+        }
+        return {c - np, std::move(perfect_columns)};
+    }
+
+    pair<seg_index,vector<bool>> compute_perfect_columns(
+        const vector<string>& msa, vector<bool>* gap_columns = nullptr) {
+        in_memory_msa rows(msa);
+        return compute_perfect_columns(rows, gap_columns);
+    }
+
+    const vector<bool> perfect_columns_dummy = {};
+    /* Extensions is vector<vector<pair<seg_index, seg_index>>> or streaming_extensions, computed
+     * with the same objective; with a size weight and perfect segments, gap_columns are required
+     * (see compute_perfect_columns) since the label of a perfect segment is its gap-free columns */
+    template <class Extensions>
+    pair<seg_index, vector<pair<seg_index, seg_index>>> segment_with_rmq(
+        Extensions& L_y, seg_index c, const vector<bool> &perfect_columns = perfect_columns_dummy,
+        const objective& obj = objective(), const vector<bool> &gap_columns = perfect_columns_dummy)
+    {
+        EDS_TRACE_SPAN("segment_with_rmq");
+        const bool allow_perfect_segments = (perfect_columns.size() > 0);
+        assert(!allow_perfect_segments or obj.size_weight == 0 or gap_columns.size() == perfect_columns.size());
+        vector<seg_index> m(c + 1, numeric_limits<seg_index>::max());      // m[y] is the DP value: minimal number of strings
+        vector<seg_index> mneg(c + 1, numeric_limits<seg_index>::min());  // store -m[y] for max-query simulation
+        vector<seg_index> back(c + 1, -1);    // traceback
+
+        // perfect segments x..y within the current run of perfect columns, by m[x-1] minus the
+        // size weight of the gap-free columns of the run before x: closed starts have a gap-free
+        // column in x..y, open ones do not and their empty label counts 1 (earliest start on ties)
+        const seg_index INF = numeric_limits<seg_index>::max();
+        seg_index closed_m = INF, closed_back = -1, open_m = INF, open_back = -1, gapfree = 0;
+
+        m[0] = 0;
+        mneg[0] = 0;
+
+        // Initial fill of keys = 0..c
+        vector<key_type> keys(c + 1);
+        for (key_type i = 0; i <= c; ++i) keys[i] = i;
+
+        // Initialize RMaxQTree with negated m-values
+        RMaxQTree rmq;
+        rmq.fillRMaxQTree(keys.data(), c + 1);
+        rmq.update(0, 0, 0);  // set index 0 with mneg[0] = 0
+
+        for (key_type y = 1; y <= c; ++y) {
+            m[y] = numeric_limits<key_type>::max();
+
+            if (allow_perfect_segments and perfect_columns[y]) {
+                if (y == 1 or !perfect_columns[y-1]) {
+                    closed_m = open_m = INF;
+                    gapfree = 0;
+                }
+                if (m[y-1] < INF and m[y-1] - obj.size_weight * gapfree < open_m) {
+                    open_m = m[y-1] - obj.size_weight * gapfree;
+                    open_back = y - 1;
+                }
+                if (gap_columns.empty() or !gap_columns[y]) {
+                    gapfree += 1;
+                    if (open_m < closed_m) {
+                        closed_m = open_m;
+                        closed_back = open_back;
+                    }
+                    open_m = INF;
+                }
+            }
+
+            const auto& L = L_y[y];
+
+            // optimal solution using L_y
+            for (size_t j = 0; j + 1 < L.size(); ++j) {
+                key_type l = L[j + 1].first;
+                key_type r = L[j].first - 1;
+                if (l > r) continue;
+
+                // query returns pair (index, value), but value is -m[index]
+                auto [x, neg_mx] = rmq.query(l, r);
+                EDS_TRACE_COUNT(RMQ_QUERIES, 1);
+                key_type candidate = L[j].second + m[x];
+
+                if (candidate < m[y]) {
+                    m[y] = candidate;
+                    back[y] = x;
+                }
+            }
+
+            if (allow_perfect_segments and perfect_columns[y]) {
+                seg_index perfect_m = INF, perfect_back = -1;
+                if (closed_m < INF) {
+                    perfect_m = closed_m + obj.cost(1, gapfree);
+                    perfect_back = closed_back;
+                }
+                if (open_m < INF and open_m + obj.cost(1, gapfree + 1) < perfect_m) {
+                    perfect_m = open_m + obj.cost(1, gapfree + 1);
+                    perfect_back = open_back;
+                }
+                if (perfect_m <= m[y]) {
+                    m[y] = perfect_m;
+                    back[y] = perfect_back;
+                }
+            }
+
+            mneg[y] = -m[y];
+            rmq.update(y, y, mneg[y]);
+        }
+
+        // Traceback
+        vector<pair<seg_index, seg_index>> segments;
+        for (key_type pos = c; pos > 0; pos = back[pos]) {
+            segments.emplace_back(back[pos] + 1, pos);
+        }
+        reverse(segments.begin(), segments.end());
+
+        return {m[c], segments};
+    }
+
+    // Greedy segmentation: from the current start column, extend the segment column by column up to U
+    // while maintaining a rolling hash of every row's gap-free label, and cut where the height per
+    // column is smallest (ties favour the longer segment); the scan restarts after the cut, so columns
+    // beyond it are hashed again. Takes O(c * U * r log r) time in the worst case (a cut after every
+    // column), and O(c * r log r) when cuts fall near U; a maximal run of perfect columns is taken as
+    // one segment when allowed.
+    // The returned cardinality is counted on hashes; segment_msa reports the exact one.
+    template <class MSA, typename = requires_column_access<MSA>>
+    pair<seg_index, vector<pair<seg_index, seg_index>>> segment_greedy(
+        MSA& msa, seg_index U, const vector<bool> &perfect_columns = perfect_columns_dummy)
+    {
+        EDS_TRACE_SPAN("segment_greedy");
+        const bool allow_perfect_segments = (perfect_columns.size() > 0);
+        const seg_index r = msa.rows();
+        const seg_index c = msa.columns();
+
+        vector<uint64_t> hashes(r);
+        vector<uint64_t> keys(r);
+        vector<seg_index> heights;
+        heights.reserve(U);
+
+        seg_index card = 0;
+        vector<pair<seg_index, seg_index>> segments;
+        for (seg_index x = 1; x <= c; ) {
+            if (allow_perfect_segments and perfect_columns[x]) {
+                seg_index y = x;
+                while (y < c and perfect_columns[y + 1])
+                    y += 1;
+                segments.emplace_back(x, y);
+                card += 1;
+                x = y + 1;
+                continue;
+            }
+
+            std::fill(hashes.begin(), hashes.end(), 0);
+            heights.clear();
+            msa.require(x, std::min(c, x + U - 1));
+            for (seg_index y = x; y <= c and y - x < U; ++y) {
+                for (seg_index i = 0; i < r; ++i) {
+                    const char ch = msa.at(i, y);
+                    if (ch != '-')
+                        hashes[i] = hash_push(hashes[i], ch);
+                    keys[i] = hashes[i];
+                }
+                // the empty label hashes to 0, distinct from every non-empty label
+                std::sort(keys.begin(), keys.end());
+                EDS_TRACE_COUNT(COLUMNS, 1);
+                EDS_TRACE_COUNT(STRINGS_HASHED, r);
+                heights.push_back(std::unique(keys.begin(), keys.end()) - keys.begin());
+            }
+
+            seg_index best = 0;
+            for (seg_index len = 1; len < (seg_index)heights.size(); ++len) {
+                // heights[len] / (len + 1) <= heights[best] / (best + 1)
+                if (heights[len] * (best + 1) <= heights[best] * (len + 1))
+                    best = len;
+            }
+            segments.emplace_back(x, x + best);
+            card += heights[best];
+            x += best + 1;
+        }
+
+        return {card, segments};
+    }
+
+    pair<seg_index, vector<pair<seg_index, seg_index>>> segment_greedy(
+        const vector<string>& msa, seg_index U, const vector<bool> &perfect_columns = perfect_columns_dummy)
+    {
+        in_memory_msa rows(msa);
+        return segment_greedy(rows, U, perfect_columns);
+    }
+
+    // Count the total cardinality of sets
+    seg_index card_eds(const vector<string>& msa, const vector<pair<seg_index, seg_index>>& segments) {
+        seg_index card = 0;
+        for (const auto& [l, r] : segments) {
+            set<string> unique_subs;
+            for (const auto& seq : msa) {
+                string sub = seq.substr(l - 1, r - l + 1);
+                sub.erase(remove(sub.begin(), sub.end(), '-'), sub.end()); // remove gaps
+                unique_subs.insert(sub);
+            }
+            card += unique_subs.size();
+        }
+        return card;
+    }
+} // namespace eds::mincard
+#endif // MINCARD_HPP
@@ -8,181 +8,35 @@
 #include <unordered_set>
 #include <chrono>
 #include <limits>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
 
-#include "RMaxQTree.h"
 #include "block_graph.hpp"
+#include "mincard.hpp"
+#include "incremental.hpp"
+#include "fasta_index.hpp"
+#include "batch.hpp"
 
 using namespace std::chrono;
 using namespace std;
-using eds::block_graph::block_graph, eds::block_graph::segment_msa, eds::block_graph::output_msa_info, eds::block_graph::output_segmentation, eds::block_graph::output_block_info, eds::block_graph::output_block_graph, eds::block_graph::output_eds;
+using eds::block_graph::block_graph, eds::block_graph::segment_msa, eds::block_graph::output_gfa, eds::block_graph::output_eds;
+using eds::io::buffered_writer;
+using eds::block_graph::segment_columns, eds::block_graph::class_graph_builder, eds::block_graph::path_spill;
+using eds::incremental::state, eds::incremental::load_state, eds::incremental::save_state, eds::incremental::add_rows, eds::incremental::extend_classes, eds::incremental::compute_classes;
+using eds::mincard::read_fasta, eds::mincard::rows_aligned, eds::mincard::compute_meaningful_extensions, eds::mincard::compute_perfect_columns, eds::mincard::segment_with_rmq, eds::mincard::segment_greedy, eds::mincard::streaming_extensions, eds::mincard::objective;
+using eds::column_store::column_window, eds::column_store::convert_fasta, eds::column_store::default_block_width, eds::column_store::in_memory_msa;
 
 bool verbose = false;
 typedef eds::block_graph::seg_index seg_index;
-typedef long long int key_type;
-
-// Reads sequences from a FASTA file
-vector<string> read_fasta(const string& filename) {
-    ifstream in(filename);
-    vector<string> sequences;
-    string line, current;
-
-    while (getline(in, line)) {
-        if (line.empty()) continue;
-        if (line[0] == '>') {
-            if (!current.empty()) {
-                sequences.push_back(current);
-                current.clear();
-            }
-        } else {
-            current += line;
-        }
-    }
-    if (!current.empty())
-        sequences.push_back(current);
-
-    return sequences;
-}
-
-vector<vector<pair<seg_index, seg_index>>> compute_meaningful_extensions(
-    const vector<string>& msa, seg_index L, seg_index U)
-{
-    seg_index r = msa.size();
-    seg_index c = msa[0].size();
-
-    vector<vector<pair<seg_index, seg_index>>> L_y(c + 1);  // 1-based indexing
-
-    for (seg_index y = 1; y <= c; ++y) {
-        if (y < L) {
-            continue;  // No extension possible
-        }
-
-        vector<pair<seg_index, seg_index>> current;
-
-        // Enforce ℓ_{y,1} = y - L + 1 down to ℓ_{y,d_y} > y - U
-        seg_index prev_height = -1;
-        for (seg_index len = L; len <= U && y - len + 1 >= 1; ++len) {
-            seg_index start = y - len + 1;
-            unordered_set<string> unique_strings;
-
-            for (seg_index i = 0; i < r; ++i) {
-                string s = msa[i].substr(start - 1, len);
-                s.erase(remove(s.begin(), s.end(), '-'), s.end());  // remove gaps
-                unique_strings.insert(s);
-            }
-
-            seg_index height = unique_strings.size();
-            if (height != prev_height) {
-                current.emplace_back(start, height);
-                prev_height = height;
-            }
-        }
-
-        // Add dummy ℓ_{y,d_y+1} = max(0, y - U)
-        current.emplace_back(max((seg_index)0, y - U), -1);
-        L_y[y] = current;
-    }
-
-    return L_y;
-}
-
-pair<seg_index,vector<bool>> compute_perfect_columns(
-    const vector<string>& msa) {
-    seg_index r = msa.size();
-    seg_index c = msa[0].size();
-    seg_index np = 0;
-    assert(r > 0);
-
-    vector<bool> perfect_columns(c + 1, true); // 1-indexed
-    for (seg_index y = 1; y <= c; ++y) {
-        const char consensus = msa[0][y-1];
-        for (seg_index i = 2; i <= r; ++i) {
-            if (msa[i-1][y-1] != consensus) {
-                perfect_columns[y] = false;
-                np += 1;
-                break;
-            }
-        }
-    }
-    return {c - np, std::move(perfect_columns)};
-}
-
-const vector<bool> perfect_columns_dummy = {};
-pair<seg_index, vector<pair<seg_index, seg_index>>> segment_with_rmq(
-    const vector<vector<pair<seg_index, seg_index>>>& L_y, seg_index c, const vector<bool> &perfect_columns = perfect_columns_dummy)
-{
-    const bool allow_perfect_segments = (perfect_columns.size() > 0);
-    vector<seg_index> m(c + 1, numeric_limits<seg_index>::max());      // m[y] is the DP value: minimal number of strings
-    vector<seg_index> mneg(c + 1, numeric_limits<seg_index>::min());  // store -m[y] for max-query simulation
-    vector<seg_index> back(c + 1, -1);    // traceback
-    seg_index perfect_back = -1, perfect_m = numeric_limits<seg_index>::max();
-    if (allow_perfect_segments and perfect_columns[0]) {
-        perfect_m = 0;
-        perfect_back = 0;
-    }
-
-    m[0] = 0;
-    mneg[0] = 0;
-
-    // Initial fill of keys = 0..c
-    vector<key_type> keys(c + 1);
-    for (key_type i = 0; i <= c; ++i) keys[i] = i;
-
-    // Initialize RMaxQTree with negated m-values
-    RMaxQTree rmq;
-    rmq.fillRMaxQTree(keys.data(), c + 1);
-    rmq.update(0, 0, 0);  // set index 0 with mneg[0] = 0
-
-    for (key_type y = 1; y <= c; ++y) {
-        m[y] = numeric_limits<key_type>::max();
-
-        const auto& L = L_y[y];
-
-        // optimal solution using L_y
-        for (size_t j = 0; j + 1 < L.size(); ++j) {
-            key_type l = L[j + 1].first;
-            key_type r = L[j].first - 1;
-            if (l > r) continue;
-
-            // query returns pair (index, value), but value is -m[index]
-            auto [x, neg_mx] = rmq.query(l, r);
-            key_type candidate = L[j].second + m[x];
-
-            if (candidate < m[y]) {
-                m[y] = candidate;
-                back[y] = x;
-            }
-        }
-
-        if (allow_perfect_segments and perfect_columns[y]) {
-            if (perfect_m < numeric_limits<seg_index>::max() and perfect_m + 1 <= m[y]) {
-                m[y] = perfect_m + 1;
-                back[y] = perfect_back;
-            }
-        }
 
-        mneg[y] = -m[y];
-        rmq.update(y, y, mneg[y]);
-
-        // optional
-        if (allow_perfect_segments and y < c and perfect_columns[y+1]) {
-            if (m[y] < perfect_m) {
-                perfect_m = m[y];
-                perfect_back = y;
-            }
-        } else if (allow_perfect_segments and y < c and !perfect_columns[y+1]) {
-            perfect_m = numeric_limits<seg_index>::max();
-            perfect_back = -1;
-        }
-    }
-
-    // Traceback
-    vector<pair<seg_index, seg_index>> segments;
-    for (key_type pos = c; pos > 0; pos = back[pos]) {
-        segments.emplace_back(back[pos] + 1, pos);
-    }
-    reverse(segments.begin(), segments.end());
-
-    return {m[c], segments};
+// Names the DP value of the objective in the log
+string objective_name(const objective& obj) {
+    if (obj.card_weight == 1 and obj.size_weight == 0)
+        return "cardinality";
+    if (obj.card_weight == 0 and obj.size_weight == 1)
+        return "gap-aware size";
+    return "cost (" + to_string(obj.card_weight) + " * cardinality + " + to_string(obj.size_weight) + " * gap-aware size)";
 }
 
 // Prseg_index EDS from segmentation
@@ -218,19 +72,255 @@ void prseg_index_eds(const vector<string>& msa, const vector<pair<seg_index, seg
         outFile.close();
 }
 
-// Count the total cardinality of sets
-seg_index card_eds(const vector<string>& msa, const vector<pair<seg_index, seg_index>>& segments) {
-    seg_index card = 0;
-    for (const auto& [l, r] : segments) {
-        set<string> unique_subs;
-        for (const auto& seq : msa) {
-            string sub = seq.substr(l - 1, r - l + 1);
-            sub.erase(remove(sub.begin(), sub.end(), '-'), sub.end()); // remove gaps
-            unique_subs.insert(sub);
+
+// Writes the block graph as GFA or EDS to out_filename ("-" for stdout); region_start > 0
+// marks a run on the columns region_start..region_start+columns-1 of the MSA (see eds-merge),
+// and the P lines come from spill if given; returns false if the output cannot be opened or written
+bool write_block_graph(const block_graph& eds, seg_index rows, seg_index columns, const vector<pair<seg_index, seg_index>>& segments, bool gfa_output, const string& out_filename, seg_index region_start = 0, path_spill* spill = nullptr) {
+    buffered_writer out(out_filename);
+    if (!out.good()) {
+        cerr << "Cannot open " << out_filename << " for writing.\n";
+        return false;
+    }
+    if (gfa_output) {
+        output_gfa(eds, rows, columns, segments, out, region_start, spill);
+        if (spill != nullptr and !spill->good()) {
+            cerr << "Cannot write or read back the paths of the GFA.\n";
+            return false;
         }
-        card += unique_subs.size();
+    } else { // eds output
+        output_eds(eds, out);
+    }
+    if (!out.close()) {
+        cerr << "Cannot write " << out_filename << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Builds the block graph of the segmentation and writes it as GFA or EDS to out_filename;
+// returns the cardinality, the gap-aware size, and whether the output was written
+tuple<seg_index, seg_index, bool> output_segmented_msa(const vector<string>& msa, const vector<string>& names, const vector<pair<seg_index, seg_index>>& segments, bool gfa_output, const string& out_filename, bool gfa_paths, seg_index region_start = 0) {
+    in_memory_msa rows(msa, &names);
+    auto [eds, card, size] = segment_columns(rows, segments, gfa_output and gfa_paths);
+    const bool written = write_block_graph(eds, msa.size(), msa[0].size(), segments, gfa_output, out_filename, region_start);
+    return {card, size, written};
+}
+
+// Out-of-core run: the MSA is converted once into a column-blocked file next to it, and the
+// perfect columns, DP or greedy, and block graph construction each stream it in windows of
+// about U columns of all rows
+int run_external(const string& filename, seg_index L, seg_index U, bool allow_perfect_segments, bool trivial_segmentation, bool greedy_segmentation, bool report_bound, bool gfa_output, const string& out_filename, bool gfa_paths, seg_index block_width, const objective& obj) {
+    const string columns_filename = filename + ".cols";
+    std::error_code ec;
+    // the cache is reused if newer than the MSA, complete, and in blocks of the requested width
+    bool stale = !std::filesystem::exists(columns_filename) or std::filesystem::last_write_time(columns_filename, ec) < std::filesystem::last_write_time(filename, ec);
+    if (!stale) {
+      column_window cached(columns_filename);
+      stale = !cached.good() or (uint64_t)cached.block_width() != ((block_width > 0) ? (uint64_t)block_width : default_block_width(cached.rows()));
+    }
+    if (stale) {
+      auto start_conv = high_resolution_clock::now();
+      if (!convert_fasta(filename, columns_filename, block_width)) {
+        cerr << "MSA file is empty, not found, or its rows differ in length.\n";
+        return 1;
+      }
+      auto stop_conv = high_resolution_clock::now();
+      cout << "Conversion to " << columns_filename << " took " << duration_cast<milliseconds>(stop_conv-start_conv).count() << " milliseconds" << endl;
+    }
+    column_window msa(columns_filename);
+    if (!msa.good()) {
+      cerr << "Cannot read " << columns_filename << ".\n";
+      return 1;
+    }
+    const seg_index c = msa.columns();
+    cerr << "MSA[1.." << msa.rows() << " ,1.." << c << "] opened, " << msa.block_width() << " columns per block" << endl;
+
+    vector<bool> perfect_columns = {}, gap_columns = {};
+    if (allow_perfect_segments and !trivial_segmentation) {
+      auto [p, p_cols] = compute_perfect_columns(msa, &gap_columns);
+      std::swap(p_cols, perfect_columns);
+      cout << "MSA contains " << p << "/" << c << " perfect columns" << endl;
+    }
+
+    vector<pair<seg_index, seg_index>> segments;
+    if (trivial_segmentation) {
+      segments.reserve(c);
+      for (seg_index i = 0; i < c; ++i)
+        segments.push_back({ i+1, i+1 });
+    } else if (greedy_segmentation) {
+      auto start_greedy = high_resolution_clock::now();
+      auto [greedy_card, greedy_segments] = segment_greedy(msa, U, perfect_columns);
+      auto stop_greedy = high_resolution_clock::now();
+      cout << "Greedy segmentation took " << duration_cast<milliseconds>(stop_greedy-start_greedy).count() << " milliseconds" << endl;
+      cout << "Greedy segmentation cardinality: " << greedy_card << endl;
+      std::swap(segments, greedy_segments);
+      if (report_bound) {
+        streaming_extensions<column_window> L_y(msa, L, U);
+        auto [cost, _] = segment_with_rmq(L_y, c, perfect_columns);
+        cout << "Minimum segmentation cardinality (DP lower bound): " << cost << endl;
+        cout << "Greedy/optimal cardinality ratio: " << ((double)greedy_card / cost) << endl;
+      }
+    } else {
+      auto start_dp = high_resolution_clock::now();
+      streaming_extensions<column_window> L_y(msa, L, U, obj);
+      auto [cost, dp_segments] = segment_with_rmq(L_y, c, perfect_columns, obj, gap_columns);
+      auto stop_dp = high_resolution_clock::now();
+      cout << "Preprocessing and DP took " << duration_cast<milliseconds>(stop_dp-start_dp).count() << " milliseconds" << endl;
+      cout << "Minimum segmentation " << objective_name(obj) << ": " << cost << endl;
+      std::swap(segments, dp_segments);
+    }
+
+    // the paths are rows x blocks node ids, so they are spilled next to the MSA instead of kept in memory
+    std::optional<path_spill> spill;
+    if (gfa_output and gfa_paths) {
+      vector<string> names;
+      for (seg_index j = 0; j < msa.rows(); ++j)
+        names.push_back(msa.name(j));
+      spill.emplace(filename + ".paths", std::move(names), segments.size());
+      if (!spill->good()) {
+        cerr << "Cannot open " << filename << ".paths for writing.\n";
+        return 1;
+      }
+    }
+    auto [eds, card, size] = segment_columns(msa, segments, false, (spill) ? &*spill : nullptr);
+    if (!msa.good()) {
+      cerr << "Cannot read " << columns_filename << ", it may be truncated; delete it to rebuild it.\n";
+      return 1;
+    }
+    const bool written = write_block_graph(eds, msa.rows(), c, segments, gfa_output, out_filename, 0, (spill) ? &*spill : nullptr);
+    cout << "Cardinality after gap removal: " << card << endl;
+    cout << "Gap-aware size after gap removal: " << size << endl;
+    return (written) ? 0 : 1;
+}
+
+// Adds the aligned rows of add_filename to the MSA whose state was saved with --save-state:
+// heights are updated where the new rows bring new labels, the DP is rerun, and the block
+// graph is patched if the segmentation did not change; U and allow_perfect_segments are those
+// given on the command line (-1 if not given), which must match the saved ones
+int run_add(const string& filename, const string& add_filename, seg_index U, int allow_perfect_segments, bool gfa_output, const string& out_filename, bool gfa_paths) {
+    const string state_filename = filename + ".state";
+    state st;
+    if (!load_state(state_filename, st)) {
+      cerr << "Cannot read " << state_filename << ", run with --save-state first.\n";
+      return 1;
+    }
+    if ((U >= 0 and U != st.U) or (allow_perfect_segments >= 0 and allow_perfect_segments != st.allow_perfect_segments)) {
+      cerr << state_filename << " was saved with segment-length-upper-bound " << st.U << " and allow-perfect-segments " << st.allow_perfect_segments << ", run with --save-state again to change them.\n";
+      return 1;
+    }
+
+    vector<string> msa, names;
+    for (const auto& source : st.sources) {
+      auto rows = read_fasta(source, &names);
+      msa.insert(msa.end(), std::make_move_iterator(rows.begin()), std::make_move_iterator(rows.end()));
     }
-    return card;
+    if ((seg_index)msa.size() != st.rows or eds::incremental::hash_rows(msa) != st.rows_hash) {
+      cerr << "The MSA files of " << state_filename << " have changed since it was saved.\n";
+      return 1;
+    }
+    auto added = read_fasta(add_filename, &names);
+    if (added.empty()) {
+      cerr << "MSA file " << add_filename << " is empty or not found.\n";
+      return 1;
+    }
+    for (auto& row : added) {
+      if ((seg_index)row.size() != st.columns) {
+        cerr << "Added rows must be aligned to the " << st.columns << " columns of the MSA.\n";
+        return 1;
+      }
+      msa.push_back(std::move(row));
+    }
+    const seg_index old_rows = st.rows, c = st.columns;
+    cerr << "MSA[1.." << old_rows << " ,1.." << c << "] + " << added.size() << " rows read" << endl;
+
+    auto start_pre = high_resolution_clock::now();
+    const seg_index changed = add_rows(st, msa);
+    auto stop_pre = high_resolution_clock::now();
+    cout << "Updating the extensions took " << duration_cast<milliseconds>(stop_pre-start_pre).count() << " milliseconds, " << changed << "/" << c << " columns changed" << endl;
+
+    vector<bool> perfect_columns = {};
+    if (st.allow_perfect_segments)
+      perfect_columns = compute_perfect_columns(msa).second;
+    auto start_dp = high_resolution_clock::now();
+    auto [cost, segments] = segment_with_rmq(st.L_y, c, perfect_columns);
+    auto stop_dp = high_resolution_clock::now();
+    cout << "DP took " << duration_cast<milliseconds>(stop_dp-start_dp).count() << " milliseconds" << endl;
+    cout << "Minimum segmentation cardinality: " << cost << endl;
+
+    auto start_graph = high_resolution_clock::now();
+    if (segments == st.S) {
+      extend_classes(st, msa, old_rows);
+      cout << "Segmentation unchanged, block graph patched" << endl;
+    } else {
+      st.classes = compute_classes(in_memory_msa(msa), segments);
+      st.S = std::move(segments);
+      cout << "Segmentation changed, block graph rebuilt" << endl;
+    }
+    class_graph_builder builder(names, st.S.size(), gfa_output and gfa_paths);
+    for (const auto& classes : st.classes)
+      builder.add_block(classes);
+    auto [eds, card, size] = builder.finish();
+    if (!write_block_graph(eds, msa.size(), c, st.S, gfa_output, out_filename))
+      return 1;
+    auto stop_graph = high_resolution_clock::now();
+    cout << "Block graph took " << duration_cast<milliseconds>(stop_graph-start_graph).count() << " milliseconds" << endl;
+    cout << "Cardinality after gap removal: " << card << endl;
+    cout << "Gap-aware size after gap removal: " << size << endl;
+
+    st.rows_hash = eds::incremental::hash_rows(msa);
+    st.sources.push_back(std::filesystem::absolute(add_filename).string());
+    if (!save_state(state_filename, st)) {
+      cerr << "Cannot write " << state_filename << ".\n";
+      return 1;
+    }
+    return 0;
+}
+
+// Reads columns a..b of every row through the .fai index of filename, built on first use
+vector<string> read_region(const string& filename, seg_index a, seg_index b, vector<string>& names) {
+    vector<eds::fasta_index::fai_record> records;
+    if (!eds::fasta_index::load_index(filename, records)) {
+      cerr << "Cannot index " << filename << ": it is empty, not found, or its lines vary in length within a sequence.\n";
+      return {};
+    }
+    for (const auto& r : records) {
+      if (a < 1 or a > b or (uint64_t)b > r.length) {
+        cerr << "Region " << a << "-" << b << " is not within the " << r.length << " columns of " << r.name << ".\n";
+        return {};
+      }
+      names.push_back(r.name);
+    }
+    auto rows = eds::fasta_index::read_region(filename, records, a, b);
+    if (rows.empty())
+      cerr << "Cannot read columns " << a << "-" << b << " of " << filename << ", it is shorter than " << filename << ".fai says.\n";
+    return rows;
+}
+
+// Segments every MSA of a manifest or directory on a pool of threads and prints the summary table
+int run_batch(const string& list, const eds::batch::options& opt, unsigned threads, const string& archive_filename) {
+    string error;
+    auto inputs = eds::batch::list_inputs(list, error);
+    if (inputs.empty()) {
+      cerr << "Batch: " << error << ".\n";
+      return 1;
+    }
+    std::optional<eds::batch::archive> combined;
+    if (!archive_filename.empty()) {
+      combined.emplace(archive_filename);
+      if (!combined->good()) {
+        cerr << "Cannot open " << archive_filename << " or " << archive_filename << ".idx for writing.\n";
+        return 1;
+      }
+    }
+    cerr << inputs.size() << " MSAs listed, " << threads << " threads" << endl;
+    auto start_batch = high_resolution_clock::now();
+    auto results = eds::batch::run(inputs, opt, threads, (combined) ? &*combined : nullptr);
+    auto stop_batch = high_resolution_clock::now();
+    eds::batch::output_summary(results, cout);
+    size_t failed = std::count_if(results.begin(), results.end(), [](const auto& r) { return !r.error.empty(); });
+    cout << "Batch of " << results.size() << " MSAs (" << failed << " failed) took " << duration_cast<milliseconds>(stop_batch-start_batch).count() << " milliseconds" << endl;
+    return (failed == 0) ? 0 : 1;
 }
 
 // Main function
@@ -241,30 +331,176 @@ int main(int argc, char* argv[]) {
     bool allow_perfect_segments = false;
     bool trivial_segmentation = false;
     bool gfa_output = false;
+    bool greedy_segmentation = false;
+    bool report_bound = false;
+    bool gfa_paths = true;
+    bool external = false;
+    seg_index block_width = 0;
+    bool save_incremental_state = false;
+    string add_filename = "";
+    objective obj;
+    string trace_filename = "";
+    bool batch = false;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    string archive_filename = "";
+    seg_index region_start = 0, region_end = 0;
+    string out_filename = "";
+
+    // options start with "--" and may appear anywhere, the rest are positional
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+      const string arg = argv[i];
+      if (arg == "--greedy")
+        greedy_segmentation = true;
+      else if (arg == "--bound")
+        report_bound = true;
+      else if (arg == "--no-paths")
+        gfa_paths = false;
+      else if (arg == "--output" and i + 1 < argc)
+        out_filename = argv[++i];
+      else if (arg == "--external")
+        external = true;
+      else if (arg == "--block-width" and i + 1 < argc)
+        block_width = atoll(argv[++i]);
+      else if (arg == "--save-state")
+        save_incremental_state = true;
+      else if (arg == "--add" and i + 1 < argc)
+        add_filename = argv[++i];
+      else if (arg == "--batch")
+        batch = true;
+      else if (arg == "--threads" and i + 1 < argc)
+        threads = std::max(1, atoi(argv[++i]));
+      else if (arg == "--archive" and i + 1 < argc)
+        archive_filename = argv[++i];
+      else if (arg == "--trace" and i + 1 < argc)
+        trace_filename = argv[++i];
+      else if (arg == "--size")
+        obj = { 0, 1 };
+      else if (arg == "--weights" and i + 2 < argc) {
+        obj.card_weight = atoll(argv[++i]);
+        obj.size_weight = atoll(argv[++i]);
+        if (obj.card_weight < 0 or obj.size_weight < 0 or obj.card_weight + obj.size_weight == 0) {
+          cerr << "--weights takes non-negative integers, not both 0\n";
+          return 1;
+        }
+      }
+      else if (arg == "--region" and i + 1 < argc) {
+        const string region = argv[++i];
+        const size_t dash = region.find('-');
+        region_start = atoll(region.substr(0, dash).c_str());
+        region_end = (dash == string::npos) ? 0 : atoll(region.substr(dash + 1).c_str());
+        if (region_start < 1 or region_end < region_start) {
+          cerr << "--region takes 1-indexed columns a-b with a <= b\n";
+          return 1;
+        }
+      }
+      else if (arg.rfind("--", 0) == 0) {
+        cerr << "Unknown option " << arg << endl;
+        return 1;
+      } else
+        args.push_back(arg);
+    }
+
+    // the graph goes to stdout, so the log goes to stderr
+    if (out_filename == "-")
+      cout.rdbuf(cerr.rdbuf());
 
     cout << "msa2eds-mincard version " << VERSION << endl;
-    if (argc<=1) {
+    if (args.empty()) {
       cout << "Syntax: " << string(argv[0]) << " msa.fasta segment-length-upper-bound (default " << U << ") allow-perfect-segments (default 0) trivial-segmentation (default 0) gfa-output (default 0) verbose (default 0)" << endl;
+      cout << "Options:" << endl;
+      cout << "  --greedy   greedy segmentation (O(columns * U * rows log rows)) instead of the minimum cardinality DP" << endl;
+      cout << "  --bound    with --greedy, also run the DP and report the greedy cardinality against the optimum" << endl;
+      cout << "  --output PATH   write the GFA/EDS to PATH instead of msa.fasta.gfa/.eds, - for stdout" << endl;
+      cout << "  --no-paths      do not write GFA P lines spelling the input sequences" << endl;
+      cout << "  --external      out-of-core mode: convert the MSA once into msa.fasta.cols and stream column blocks from it" << endl;
+      cout << "                  (the GFA paths are spilled to msa.fasta.paths while the graph is built)" << endl;
+      cout << "  --block-width N columns per block of msa.fasta.cols (default about 16 MiB per block)" << endl;
+      cout << "  --save-state    save L_y, the segmentation and its row classes to msa.fasta.state (minimum cardinality only)" << endl;
+      cout << "  --add NEW.fasta add the rows of NEW.fasta, aligned to the MSA, using and updating msa.fasta.state (and its upper bound and perfect segments)" << endl;
+      cout << "  --size          minimize the gap-aware size (sum of max(|label|, 1)) instead of the cardinality" << endl;
+      cout << "  --weights C S   minimize C * cardinality + S * gap-aware size" << endl;
+      cout << "  --batch         msa.fasta is a directory of MSAs (.fa, .fasta, .fas, .afa, .mfa, .aln) or a file listing one MSA per line (relative to the file);" << endl;
+      cout << "                  each gets msa.gfa/.eds, and a summary table is printed" << endl;
+      cout << "  --threads N     with --batch, MSAs segmented in parallel, largest first (default all cores)" << endl;
+      cout << "  --archive PATH  with --batch, append all outputs to PATH, indexed by MSA, offset and length in PATH.idx" << endl;
+      cout << "  --trace PATH    write a Chrome/Perfetto trace of the run to PATH (builds with make TRACE=1)" << endl;
+      cout << "  --region a-b    segment only columns a..b, read through msa.fasta.fai, into msa.fasta.a-b.gfa/.eds (see eds-merge)" << endl;
       return 0;
     }
 
-    filename = string(argv[1]);
-    if (argc>2)
-      U = atoi(argv[2]);
-    if (argc>3)
-      allow_perfect_segments = atoi(argv[3]) > 0;
-    if (argc>4)
-      trivial_segmentation = atoi(argv[4]) > 0;
-    if (argc>5)
-      gfa_output = atoi(argv[5]) > 0;
-    if (argc>6)
-      verbose = atoi(argv[6]);
-    cout << "Input file: " << filename << ", upper bound: " << U << ", allow-perfect-segments: " << ((allow_perfect_segments) ? "true" : "false") << ", trivial-segmentation: " << ((trivial_segmentation) ? "true" : "false") << ", gfa-output: " << ((gfa_output) ? "true" : "false") << ", verbose: " << ((verbose) ? "true" : "false") << endl;
-
-    auto msa = read_fasta(filename);
+    filename = args[0];
+    if (args.size()>1)
+      U = atoi(args[1].c_str());
+    if (args.size()>2)
+      allow_perfect_segments = atoi(args[2].c_str()) > 0;
+    if (args.size()>3)
+      trivial_segmentation = atoi(args[3].c_str()) > 0;
+    if (args.size()>4)
+      gfa_output = atoi(args[4].c_str()) > 0;
+    if (args.size()>5)
+      verbose = atoi(args[5].c_str());
+    if (out_filename.empty() and !batch)
+      out_filename = filename + ((region_start > 0) ? "." + to_string(region_start) + "-" + to_string(region_end) : "") + ((gfa_output) ? ".gfa" : ".eds");
+    cout << "Input file: " << filename << ", upper bound: " << U << ", allow-perfect-segments: " << ((allow_perfect_segments) ? "true" : "false") << ", trivial-segmentation: " << ((trivial_segmentation) ? "true" : "false") << ", gfa-output: " << ((gfa_output) ? "true" : "false") << ", verbose: " << ((verbose) ? "true" : "false") << ", greedy: " << ((greedy_segmentation) ? "true" : "false") << endl;
+
+    if (!trace_filename.empty() and !eds::trace::enabled) {
+      cerr << "--trace requires a build with tracing, make clean and make TRACE=1.\n";
+      return 1;
+    }
+    eds::trace::output_on_exit trace_output(trace_filename);
+    if (batch and (external or region_start > 0 or save_incremental_state or !add_filename.empty() or !out_filename.empty() or report_bound or block_width > 0 or verbose)) {
+      cerr << "--batch cannot be combined with --external, --region, --save-state, --add, --output, --bound, --block-width or verbose output.\n";
+      return 1;
+    }
+    if ((obj.card_weight != 1 or obj.size_weight != 0) and (trivial_segmentation or greedy_segmentation or save_incremental_state or !add_filename.empty())) {
+      cerr << "--size and --weights require the DP segmentation, without --save-state or --add.\n";
+      return 1;
+    }
+    if (region_start > 0 and (external or save_incremental_state or !add_filename.empty())) {
+      cerr << "--region cannot be combined with --external, --save-state or --add.\n";
+      return 1;
+    }
+    if (greedy_segmentation and U < 1) {
+      cerr << "Greedy segmentation requires segment-length-upper-bound >= 1.\n";
+      return 1;
+    }
+    if (batch) {
+      eds::batch::options opt;
+      opt.L = L;
+      opt.U = U;
+      opt.allow_perfect_segments = allow_perfect_segments;
+      opt.trivial_segmentation = trivial_segmentation;
+      opt.greedy_segmentation = greedy_segmentation;
+      opt.gfa_output = gfa_output;
+      opt.gfa_paths = gfa_paths;
+      opt.obj = obj;
+      return run_batch(filename, opt, threads, archive_filename);
+    }
+    if (!add_filename.empty() and (trivial_segmentation or greedy_segmentation or report_bound or external or block_width > 0)) {
+      cerr << "--add updates the saved minimum cardinality segmentation in memory, it cannot be combined with trivial segmentation, --greedy, --bound, --external or --block-width.\n";
+      return 1;
+    }
+    if (!add_filename.empty())
+      return run_add(filename, add_filename, (args.size() > 1) ? U : -1, (args.size() > 2) ? allow_perfect_segments : -1, gfa_output, out_filename, gfa_paths);
+    if (save_incremental_state and (external or trivial_segmentation or greedy_segmentation)) {
+      cerr << "--save-state requires the in-memory minimum cardinality segmentation.\n";
+      return 1;
+    }
+    if (external)
+      return run_external(filename, L, U, allow_perfect_segments, trivial_segmentation, greedy_segmentation, report_bound, gfa_output, out_filename, gfa_paths, block_width, obj);
+
+    vector<string> names;
+    auto msa = (region_start > 0) ? read_region(filename, region_start, region_end, names) : read_fasta(filename, &names);
     if (msa.empty()) {
-      cerr << "MSA file is empty or not found.\n";
+      if (region_start == 0)
+        cerr << "MSA file is empty or not found.\n";
+      return 1;
+    } else if (!rows_aligned(msa)) {
+      cerr << "MSA rows differ in length.\n";
       return 1;
+    } else if (region_start > 0) {
+      cerr << "MSA[1.." << msa.size() << " ," << region_start << ".." << region_end << "] read" << endl;
     } else {
       cerr << "MSA[1.." << msa.size() << " ,1.." << msa[0].size() << "] read" << endl;
     }
@@ -275,24 +511,49 @@ int main(int argc, char* argv[]) {
       for (seg_index i = 0; i < msa[0].size(); ++i) {
         trivial.push_back({ i+1, i+1 });
       }
-      auto [eds, card, size] = segment_msa(filename, msa[0].size(), trivial);
-      if (gfa_output) {
-          ofstream out(filename + ".gfa");
-          output_msa_info(msa.size(), msa[0].size(), out);
-          output_segmentation(trivial, out);
-          output_block_info(eds, out);
-          output_block_graph(eds, out);
-      } else { // eds output
-          ofstream out(filename + ".eds");
-          output_eds(eds, out);
-      }
+      auto [card, size, written] = output_segmented_msa(msa, names, trivial, gfa_output, out_filename, gfa_paths, region_start);
       cout << "Cardinality: " << card << endl;
       cout << "Gap-aware size: " << size << endl;
-      return 0;
+      return (written) ? 0 : 1;
+    } else if (greedy_segmentation) {
+      vector<bool> perfect_columns = {};
+      if (allow_perfect_segments) {
+              auto [p, p_cols] = compute_perfect_columns(msa);
+              std::swap(p_cols, perfect_columns);
+              cout << "MSA contains " << p << "/" << msa[0].size() << " perfect columns" << endl;
+      }
+      auto start_greedy = high_resolution_clock::now();
+      auto [greedy_card, segments] = segment_greedy(msa, U, perfect_columns);
+      auto stop_greedy = high_resolution_clock::now();
+      auto duration = duration_cast<milliseconds>(stop_greedy-start_greedy);
+      cout << "Greedy segmentation took " << duration.count() << " milliseconds" << endl;
+      cout << "Greedy segmentation cardinality: " << greedy_card << endl;
+
+      if (report_bound) {
+          auto start_dp = high_resolution_clock::now();
+          auto L_y = compute_meaningful_extensions(msa, L, U);
+          auto [cost, _] = segment_with_rmq(L_y, msa[0].size(), perfect_columns);
+          auto stop_dp = high_resolution_clock::now();
+          duration = duration_cast<milliseconds>(stop_dp-start_dp);
+          cout << "Preprocessing and DP took " << duration.count() << " milliseconds" << endl;
+          cout << "Minimum segmentation cardinality (DP lower bound): " << cost << endl;
+          cout << "Greedy/optimal cardinality ratio: " << ((double)greedy_card / cost) << endl;
+      }
+      if (verbose) {
+         cout << "Segments:\n";
+         for (auto [l, r] : segments)
+             cout << "[" << l << "," << r << "] ";
+         cout << "\n";
+      }
+
+      auto [card, size, written] = output_segmented_msa(msa, names, segments, gfa_output, out_filename, gfa_paths, region_start);
+      cout << "Cardinality after gap removal: " << card << endl;
+      cout << "Gap-aware size after gap removal: " << size << endl;
+      return (written) ? 0 : 1;
     } else {
       // mincard
       auto start_pre = high_resolution_clock::now();
-      auto L_y = compute_meaningful_extensions(msa, L, U);
+      auto L_y = compute_meaningful_extensions(msa, L, U, obj);
       auto stop_pre = high_resolution_clock::now();
       auto duration = duration_cast<milliseconds>(stop_pre-start_pre);
       cout << "Preprocessing took " << duration.count() << " milliseconds" << endl;
@@ -307,19 +568,19 @@ int main(int argc, char* argv[]) {
           }
       }
 
-      vector<bool> perfect_columns = {};
+      vector<bool> perfect_columns = {}, gap_columns = {};
       if (allow_perfect_segments) {
-              auto [p, p_cols] = compute_perfect_columns(msa);
+              auto [p, p_cols] = compute_perfect_columns(msa, &gap_columns);
               std::swap(p_cols, perfect_columns);
               cout << "MSA contains " << p << "/" << msa[0].size() << " perfect columns" << endl;
       }
       auto start_dp = high_resolution_clock::now();
-      auto [cost, segments] = segment_with_rmq(L_y, msa[0].size(), perfect_columns);
+      auto [cost, segments] = segment_with_rmq(L_y, msa[0].size(), perfect_columns, obj, gap_columns);
       auto stop_dp = high_resolution_clock::now();
       duration = duration_cast<milliseconds>(stop_dp-start_dp);
       cout << "DP took " << duration.count() << " milliseconds" << endl;
 
-      cout << "Minimum segmentation cardinality: " << cost << endl;
+      cout << "Minimum segmentation " << objective_name(obj) << ": " << cost << endl;
       if (verbose) {
          cout << "Segments:\n";
          for (auto [l, r] : segments)
@@ -329,19 +590,29 @@ int main(int argc, char* argv[]) {
          prseg_index_eds(msa, segments);
       }
 
-      auto [eds, card, size] = segment_msa(filename, msa[0].size(), segments);
-      if (gfa_output) {
-          ofstream out(filename + ".gfa");
-          output_msa_info(msa.size(), msa[0].size(), out);
-          output_segmentation(segments, out);
-          output_block_info(eds, out);
-          output_block_graph(eds, out);
-      } else { // eds output
-          ofstream out(filename + ".eds");
-          output_eds(eds, out);
-      }
+      auto [card, size, written] = output_segmented_msa(msa, names, segments, gfa_output, out_filename, gfa_paths, region_start);
       cout << "Cardinality after gap removal: " << card << endl;
       cout << "Gap-aware size after gap removal: " << size << endl;
+      if (!written)
+          return 1;
+
+      if (save_incremental_state) {
+          state st;
+          st.L = L;
+          st.U = U;
+          st.allow_perfect_segments = allow_perfect_segments;
+          st.sources = { std::filesystem::absolute(filename).string() };
+          st.rows = msa.size();
+          st.columns = msa[0].size();
+          st.rows_hash = eds::incremental::hash_rows(msa);
+          st.classes = compute_classes(in_memory_msa(msa), segments);
+          st.L_y = std::move(L_y);
+          st.S = std::move(segments);
+          if (!save_state(filename + ".state", st)) {
+              cerr << "Cannot write " << filename << ".state.\n";
+              return 1;
+          }
+      }
       return 0;
     }
 }
@@ -0,0 +1,279 @@
+#ifndef REGION_MERGE_HPP
+#define REGION_MERGE_HPP
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "writer.hpp"
+
+/* concatenation of the GFA or EDS outputs of runs on consecutive column regions of one MSA
+ * (msa2eds-mincard --region a-b) into the output for the union of the regions */
+namespace eds::region_merge {
+    typedef long long seg_index;
+    using eds::io::buffered_writer;
+
+    /* everything of a region GFA except its S and L lines, which are streamed when merging */
+    struct region_gfa {
+        std::string path;
+        seg_index rows = -1, a = 0, b = 0;
+        std::vector<seg_index> starts; // of all segments, in MSA columns (X line and last start)
+        std::vector<unsigned long> block_sizes;
+        unsigned long nodes = 0; // node ids are 0..nodes-1
+        std::vector<std::pair<std::string, std::vector<unsigned long>>> paths;
+    };
+
+    namespace detail {
+        inline std::vector<std::string> split(const std::string &line, char separator) {
+            std::vector<std::string> fields(1);
+            for (const char ch : line) {
+                if (ch == separator)
+                    fields.emplace_back();
+                else
+                    fields.back().push_back(ch);
+            }
+            return fields;
+        }
+
+        /* returns: false unless all of field is a number, stored in value */
+        template <typename T>
+        bool parse(const std::string &field, T &value) {
+            const char *end = field.data() + field.size();
+            auto [last, ec] = std::from_chars(field.data(), end, value);
+            return ec == std::errc() and last == end and !field.empty();
+        }
+    }
+
+    /* returns: false with a message in error if path is not a GFA written by a region run */
+    bool read_region_gfa(const std::string &path, region_gfa &r, std::string &error) {
+        std::ifstream in(path);
+        if (!in) {
+            error = "cannot read " + path;
+            return false;
+        }
+        r = region_gfa();
+        r.path = path;
+        std::string line;
+        unsigned long segments_seen = 0, total_nodes = 0;
+        seg_index last_start = 0; // not on the X line, see output_region
+        while (std::getline(in, line)) {
+            if (line.empty())
+                continue;
+            const auto fields = detail::split(line, '\t');
+            bool parsed = true;
+            if (fields[0] == "M" and fields.size() >= 3) {
+                seg_index columns = 0;
+                parsed = detail::parse(fields[1], r.rows) and detail::parse(fields[2], columns);
+            } else if (fields[0] == "R" and fields.size() >= 4) {
+                parsed = detail::parse(fields[1], r.a) and detail::parse(fields[2], r.b) and detail::parse(fields[3], last_start);
+            } else if (fields[0] == "X") {
+                r.starts.resize(fields.size() - 1);
+                for (std::size_t i = 1; i < fields.size() and parsed; i++)
+                    parsed = detail::parse(fields[i], r.starts[i - 1]);
+            } else if (fields[0] == "B") {
+                r.block_sizes.resize(fields.size() - 1);
+                for (std::size_t i = 1; i < fields.size() and parsed; i++) {
+                    parsed = detail::parse(fields[i], r.block_sizes[i - 1]);
+                    total_nodes += r.block_sizes[i - 1];
+                }
+            } else if (fields[0] == "S" and fields.size() >= 3) {
+                unsigned long id = 0;
+                parsed = detail::parse(fields[1], id);
+                r.nodes = std::max(r.nodes, id + 1);
+                segments_seen += 1;
+            } else if (fields[0] == "P" and fields.size() >= 3) {
+                r.paths.emplace_back(fields[1], std::vector<unsigned long>());
+                for (auto &step : detail::split(fields[2], ',')) {
+                    unsigned long id = 0;
+                    parsed = parsed and step.size() > 1 and step.back() == '+' and detail::parse(step.substr(0, step.size() - 1), id);
+                    r.paths.back().second.push_back(id);
+                }
+            } else if (fields[0] == "M" or fields[0] == "R" or fields[0] == "S" or fields[0] == "P") {
+                parsed = false;
+            }
+            if (!parsed) {
+                error = path + " has a malformed " + fields[0] + " line";
+                return false;
+            }
+        }
+        if (r.rows < 0 or r.a == 0) {
+            error = path + " has no M or R line, write it with msa2eds-mincard --region";
+            return false;
+        }
+        r.starts.push_back(last_start);
+        if (r.starts.size() != r.block_sizes.size() or segments_seen != total_nodes or r.nodes != total_nodes) {
+            error = path + " has inconsistent X, B and S lines";
+            return false;
+        }
+        for (auto &[_, steps] : r.paths) {
+            for (auto id : steps) {
+                if (id >= r.nodes) {
+                    error = path + " has a P line through a node without an S line";
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /* requires: inputs are region GFAs of the same MSA with consecutive regions, in order,
+     * each with the P lines of the same rows (not written with --no-paths)
+     * node ids are offset by the nodes of the earlier regions, and the regions are joined by
+     * the edges the rows take from the last block of a region to the first of the next */
+    bool merge_gfa(const std::vector<std::string> &inputs, buffered_writer &out, std::string &error) {
+        std::vector<region_gfa> regions(inputs.size());
+        for (std::size_t k = 0; k < inputs.size(); k++) {
+            if (!read_region_gfa(inputs[k], regions[k], error))
+                return false;
+            if (k == 0)
+                continue;
+            const region_gfa &p = regions[k - 1], &r = regions[k];
+            if (r.rows != p.rows or r.a != p.b + 1) {
+                error = inputs[k] + " does not continue the region of " + inputs[k - 1];
+                return false;
+            }
+        }
+        // without the paths, the junctions between the regions are unknown
+        for (auto &r : regions) {
+            bool consistent = r.paths.size() == (std::size_t)r.rows;
+            for (std::size_t j = 0; consistent and j < r.paths.size(); j++)
+                consistent = r.paths[j].first == regions[0].paths[j].first and !r.paths[j].second.empty();
+            if (!consistent) {
+                error = "region GFAs must carry consistent P lines, " + r.path + " has none or other rows";
+                return false;
+            }
+        }
+
+        out << "M\t" << regions[0].rows << "\t" << regions.back().b - regions[0].a + 1 << "\n";
+        // as a run on all regions: the last start of every region but the last goes on the X line
+        out << "R\t" << regions[0].a << "\t" << regions.back().b << "\t" << regions.back().starts.back() << "\n";
+        out << "X";
+        for (std::size_t k = 0; k < regions.size(); k++)
+            for (std::size_t i = 0; i < regions[k].starts.size(); i++)
+                if (k + 1 < regions.size() or i + 1 < regions[k].starts.size())
+                    out << "\t" << regions[k].starts[i];
+        out << "\n";
+        out << "B";
+        for (auto &r : regions)
+            for (auto size : r.block_sizes)
+                out << "\t" << size;
+        out << "\n";
+
+        unsigned long offset = 0;
+        std::string line;
+        std::set<std::pair<unsigned long, unsigned long>> junction;
+        for (std::size_t k = 0; k < regions.size(); k++) {
+            std::ifstream in(inputs[k]);
+            while (std::getline(in, line)) {
+                if (line.size() < 2 or (line[0] != 'S' and line[0] != 'L'))
+                    continue;
+                auto fields = detail::split(line, '\t');
+                unsigned long u = 0, v = 0;
+                if (fields[0] == "S" and fields.size() >= 3 and detail::parse(fields[1], u)) {
+                    out << "S\t" << u + offset << "\t" << fields[2] << "\n";
+                } else if (fields[0] == "L" and fields.size() >= 4 and detail::parse(fields[1], u) and detail::parse(fields[3], v) and u < regions[k].nodes and v < regions[k].nodes) {
+                    out << "L\t" << u + offset << "\t+\t" << v + offset << "\t+\t0M\n";
+                } else if (fields[0] == "S" or fields[0] == "L") {
+                    error = inputs[k] + " has a malformed " + fields[0] + " line";
+                    return false;
+                }
+            }
+            const unsigned long next_offset = offset + regions[k].nodes;
+            if (k + 1 < regions.size()) {
+                const region_gfa &r = regions[k], &next = regions[k + 1];
+                junction.clear();
+                for (std::size_t j = 0; j < r.paths.size(); j++)
+                    junction.insert({ r.paths[j].second.back(), next.paths[j].second.front() });
+                for (auto [u, v] : junction)
+                    out << "L\t" << u + offset << "\t+\t" << v + next_offset << "\t+\t0M\n";
+            }
+            offset = next_offset;
+        }
+
+        for (std::size_t j = 0; j < regions[0].paths.size(); j++) {
+            out << "P\t" << regions[0].paths[j].first << "\t";
+            offset = 0;
+            bool first = true;
+            for (auto &r : regions) {
+                for (auto id : r.paths[j].second) {
+                    if (!first)
+                        out << ',';
+                    out << id + offset << '+';
+                    first = false;
+                }
+                offset += r.nodes;
+            }
+            out << "\t*\n";
+        }
+        return true;
+    }
+
+    /* returns: false unless path ends in .a-b.eds, as named by a region run, with a and b
+     * stored in r */
+    bool eds_region_of_name(const std::string &path, region_gfa &r) {
+        const std::string suffix = ".eds";
+        if (path.size() < suffix.size() or path.compare(path.size() - suffix.size(), suffix.size(), suffix) != 0)
+            return false;
+        const std::string stem = path.substr(0, path.size() - suffix.size());
+        const auto dot = stem.rfind('.'), dash = stem.rfind('-');
+        if (dot == std::string::npos or dash == std::string::npos or dash < dot)
+            return false;
+        return detail::parse(stem.substr(dot + 1, dash - dot - 1), r.a) and detail::parse(stem.substr(dash + 1), r.b) and r.a >= 1 and r.a <= r.b;
+    }
+
+    /* returns: false unless line is a sequence of {...} blocks */
+    bool is_eds_line(const std::string &line) {
+        bool open = false;
+        for (const char ch : line) {
+            if (ch == '{' or ch == '}') {
+                if (open != (ch == '}'))
+                    return false;
+                open = !open;
+            } else if (!open) {
+                return false;
+            }
+        }
+        return !line.empty() and !open;
+    }
+
+    /* requires: inputs are EDS outputs of consecutive regions, in order, under the .a-b.eds
+     * names of their region runs (an EDS does not record its columns otherwise)
+     * returns: false with a message in error if an input is not a one-line EDS or does not
+     * continue the region of the previous one */
+    bool merge_eds(const std::vector<std::string> &inputs, buffered_writer &out, std::string &error) {
+        region_gfa p;
+        for (size_t k = 0; k < inputs.size(); k++) {
+            region_gfa r;
+            if (!eds_region_of_name(inputs[k], r)) {
+                error = inputs[k] + " is not named .a-b.eds by a region run, so its columns are unknown";
+                return false;
+            }
+            if (k > 0 and r.a != p.b + 1) {
+                error = inputs[k] + " does not continue the region of " + inputs[k - 1];
+                return false;
+            }
+            p = r;
+        }
+        std::string line, rest;
+        for (auto &path : inputs) {
+            std::ifstream in(path);
+            if (!in) {
+                error = "cannot read " + path;
+                return false;
+            }
+            std::getline(in, line);
+            if (!is_eds_line(line) or std::getline(in, rest)) {
+                error = path + " is not an EDS of one line of {...} blocks";
+                return false;
+            }
+            out << line;
+        }
+        out << "\n";
+        return true;
+    }
+} // namespace eds::region_merge
+#endif // REGION_MERGE_HPP
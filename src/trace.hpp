@@ -0,0 +1,151 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+#include <cstdint>
+#include <string>
+
+/* optional tracing of the hot paths, compiled in with -DEDS_TRACE (make TRACE=1): scoped spans
+ * per thread with counters, written as Chrome trace JSON for chrome://tracing or ui.perfetto.dev
+ * without EDS_TRACE, EDS_TRACE_SPAN and EDS_TRACE_COUNT expand to nothing */
+namespace eds::trace {
+    enum counter { COLUMNS, STRINGS_HASHED, RMQ_QUERIES, BLOCKS_EMITTED, COUNTERS };
+    const char *const counter_names[COUNTERS] = { "columns processed", "strings hashed", "RMQ queries", "blocks emitted" };
+} // namespace eds::trace
+
+#ifdef EDS_TRACE
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace eds::trace {
+    const bool enabled = true;
+
+    /* a finished span, with the counters of its thread when it began and ended */
+    struct event {
+        const char *name;
+        int64_t begin, duration; // microseconds since the first span
+        uint64_t counters_begin[COUNTERS], counters_end[COUNTERS];
+    };
+
+    /* events and counters of one thread, appended to without locking; owned by the registry
+     * so that they outlive the thread */
+    struct thread_buffer {
+        uint32_t tid = 0;
+        std::vector<event> events;
+        uint64_t counters[COUNTERS] = {};
+    };
+
+    namespace detail {
+        std::mutex registry_mutex;
+        std::vector<std::unique_ptr<thread_buffer>> registry;
+        const auto epoch = std::chrono::steady_clock::now();
+
+        inline int64_t now() {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - epoch).count();
+        }
+
+        inline thread_buffer &local() {
+            thread_local thread_buffer *buffer = nullptr;
+            if (buffer == nullptr) {
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                registry.push_back(std::make_unique<thread_buffer>());
+                buffer = registry.back().get();
+                buffer->tid = registry.size();
+                buffer->events.reserve(1024);
+            }
+            return *buffer;
+        }
+    }
+
+    inline void count(counter c, uint64_t n) {
+        detail::local().counters[c] += n;
+    }
+
+    class span {
+    private:
+        thread_buffer &buffer;
+        event e;
+
+    public:
+        explicit span(const char *name) : buffer(detail::local()) {
+            e.name = name;
+            std::copy(buffer.counters, buffer.counters + COUNTERS, e.counters_begin);
+            e.begin = detail::now();
+        }
+        span(const span &) = delete;
+        span &operator=(const span &) = delete;
+        ~span() {
+            e.duration = detail::now() - e.begin;
+            std::copy(buffer.counters, buffer.counters + COUNTERS, e.counters_end);
+            buffer.events.push_back(e);
+        }
+    };
+
+    /* requires: no thread is inside a span
+     * writes a complete event per span, with the counters it advanced as arguments, and a
+     * counter event per span end with the running totals of its thread */
+    bool write(const std::string &path) {
+        std::ofstream out(path);
+        std::lock_guard<std::mutex> lock(detail::registry_mutex);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        auto separator = [&]() { out << ((first) ? "\n" : ",\n"); first = false; };
+        for (auto &buffer : detail::registry) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid << ",\"args\":{\"name\":\"thread " << buffer->tid << "\"}}";
+            for (auto &e : buffer->events) {
+                separator();
+                out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << e.begin << ",\"dur\":" << e.duration << ",\"args\":{";
+                bool first_arg = true;
+                for (int c = 0; c < COUNTERS; c++) {
+                    if (e.counters_end[c] == e.counters_begin[c])
+                        continue;
+                    out << ((first_arg) ? "" : ",") << "\"" << counter_names[c] << "\":" << e.counters_end[c] - e.counters_begin[c];
+                    first_arg = false;
+                }
+                out << "}}";
+                separator();
+                out << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << e.begin + e.duration << ",\"args\":{";
+                for (int c = 0; c < COUNTERS; c++)
+                    out << ((c == 0) ? "" : ",") << "\"" << counter_names[c] << "\":" << e.counters_end[c];
+                out << "}}";
+            }
+        }
+        out << "\n]}\n";
+        return out.good();
+    }
+} // namespace eds::trace
+
+#define EDS_TRACE_CONCAT_(a, b) a##b
+#define EDS_TRACE_CONCAT(a, b) EDS_TRACE_CONCAT_(a, b)
+#define EDS_TRACE_SPAN(name) eds::trace::span EDS_TRACE_CONCAT(eds_trace_span_, __LINE__)(name)
+#define EDS_TRACE_COUNT(c, n) eds::trace::count(eds::trace::c, (n))
+#else
+namespace eds::trace {
+    const bool enabled = false;
+    inline bool write(const std::string &) { return false; }
+} // namespace eds::trace
+
+#define EDS_TRACE_SPAN(name) ((void)0)
+#define EDS_TRACE_COUNT(c, n) ((void)0)
+#endif // EDS_TRACE
+
+#include <iostream>
+
+namespace eds::trace {
+    /* writes the trace to path, unless empty, when it goes out of scope at the end of main */
+    class output_on_exit {
+    private:
+        std::string path;
+
+    public:
+        explicit output_on_exit(const std::string &path) : path(path) {}
+        ~output_on_exit() {
+            if (!path.empty() and !write(path))
+                std::cerr << "Cannot write the trace to " << path << ".\n";
+        }
+    };
+} // namespace eds::trace
+#endif // TRACE_HPP
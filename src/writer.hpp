@@ -0,0 +1,114 @@
+#ifndef WRITER_HPP
+#define WRITER_HPP
+#include <cstdio>
+#include <cstring>
+#include <charconv>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace eds::io {
+    /* output file with a large user-space buffer; integers are formatted with std::to_chars
+     * path "-" streams to stdout, so the output can also be piped to a downstream tool, and
+     * a string sink collects the output in memory (e.g. for an archive) */
+    class buffered_writer {
+    private:
+        std::FILE *file;
+        bool owned;
+        std::string *sink = nullptr;
+        std::vector<char> buffer;
+        std::size_t used = 0;
+        bool failed = false; // the file could not be opened, written or closed
+
+        void reserve(std::size_t n) {
+            if (used + n > buffer.size())
+                flush();
+        }
+
+        void put(const char *s, std::size_t n) {
+            if (file != nullptr)
+                failed = failed or std::fwrite(s, 1, n, file) != n;
+            else if (sink != nullptr)
+                sink->append(s, n);
+        }
+
+    public:
+        explicit buffered_writer(const std::string &path, std::size_t capacity = 1 << 22)
+            : buffer(capacity) {
+            if (path == "-") {
+                file = stdout;
+                owned = false;
+            } else {
+                file = std::fopen(path.c_str(), "wb");
+                owned = true;
+            }
+            failed = (file == nullptr);
+        }
+
+        /* appends to *sink, which keeps its capacity between outputs if cleared by the caller */
+        explicit buffered_writer(std::string *sink, std::size_t capacity = 1 << 16)
+            : file(nullptr), owned(false), sink(sink), buffer(capacity) {}
+
+        buffered_writer(const buffered_writer &) = delete;
+        buffered_writer &operator=(const buffered_writer &) = delete;
+
+        ~buffered_writer() {
+            close();
+        }
+
+        /* false if the file could not be opened, or a write failed so far */
+        bool good() const { return !failed; }
+
+        /* flushes and closes the file (flushes stdout)
+         * returns: false if anything written was lost, e.g. on a full disk */
+        bool close() {
+            flush();
+            if (file != nullptr and owned)
+                failed = std::fclose(file) != 0 or failed;
+            else if (file != nullptr)
+                failed = std::fflush(file) != 0 or failed;
+            file = nullptr;
+            return !failed;
+        }
+
+        void flush() {
+            if (used > 0)
+                put(buffer.data(), used);
+            used = 0;
+        }
+
+        void write(const char *s, std::size_t n) {
+            if (n > buffer.size()) {
+                // larger than the whole buffer, bypass it
+                flush();
+                put(s, n);
+                return;
+            }
+            reserve(n);
+            std::memcpy(buffer.data() + used, s, n);
+            used += n;
+        }
+
+        buffered_writer &operator<<(char ch) {
+            reserve(1);
+            buffer[used++] = ch;
+            return *this;
+        }
+        buffered_writer &operator<<(const std::string &s) {
+            write(s.data(), s.size());
+            return *this;
+        }
+        buffered_writer &operator<<(const char *s) {
+            write(s, std::strlen(s));
+            return *this;
+        }
+        template <typename T, typename = std::enable_if_t<std::is_integral_v<T> and not std::is_same_v<T, char> and not std::is_same_v<T, bool>>>
+        buffered_writer &operator<<(T value) {
+            reserve(24); // enough for any 64-bit integer
+            auto [end, _] = std::to_chars(buffer.data() + used, buffer.data() + used + 24, value);
+            used = end - buffer.data();
+            return *this;
+        }
+    };
+} // namespace eds::io
+#endif // WRITER_HPP